@@ -23,27 +23,21 @@ get_time_slot (sheet_t *worksheet,
     return worksheet->data[0][j];
 }
 
-sheet_t
-read_csv (const char *path)
+/* Parse an open CSV stream, `data` is NULL if memory runs out */
+static sheet_t
+read_csv_stream (FILE *file,
+                 const char *path)
 {
-    FILE *file = fopen(path, "r");
-    if (!file)
-    {
-        perror("Failed to open file");
-        exit(EXIT_FAILURE);
-    }
-
     sheet_t sheet;
     sheet.path = strdup(path);
     sheet.rows = get_rcount(file);
     sheet.cols = get_ccount(file);
 
-    sheet.data = (char ***) malloc (sheet.rows * sizeof(char **));
+    sheet.data = (char ***) calloc (sheet.rows > 0 ? sheet.rows : 1, sizeof(char **));
     if (!sheet.data)
     {
         perror("Failed to allocate data array");
-        fclose(file);
-        exit(EXIT_FAILURE);
+        return sheet;
     }
 
     fseek(file, 0, SEEK_SET);
@@ -54,8 +48,17 @@ read_csv (const char *path)
         if (!sheet.data[i])
         {
             perror("Failed to allocate row");
-            fclose(file);
-            exit(EXIT_FAILURE);
+            for (int k = 0; k < i; ++k)
+            {
+                for (int j = 0; j < sheet.cols; ++j)
+                {
+                    free(sheet.data[k][j]);
+                }
+                free(sheet.data[k]);
+            }
+            free(sheet.data);
+            sheet.data = NULL;
+            return sheet;
         }
 
         for (int j = 0; j < sheet.cols; ++j)
@@ -69,6 +72,71 @@ read_csv (const char *path)
         }
     }
 
+    return sheet;
+}
+
+sheet_t
+read_csv (const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        perror("Failed to open file");
+        exit(EXIT_FAILURE);
+    }
+
+    sheet_t sheet = read_csv_stream(file, path);
+    fclose(file);
+
+    if (!sheet.data)
+    {
+        exit(EXIT_FAILURE);
+    }
+    return sheet;
+}
+
+sheet_t
+try_read_csv (const char *path)
+{
+    sheet_t sheet = { NULL, 0, 0, NULL };
+
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        return sheet;
+    }
+
+    sheet = read_csv_stream(file, path);
+    fclose(file);
+    return sheet;
+}
+
+sheet_t
+read_csv_buffer (const char *text,
+                 size_t size,
+                 const char *name)
+{
+    sheet_t sheet = { NULL, 0, 0, NULL };
+
+#if defined(_WIN32) || defined(_WIN64)
+    FILE *file = tmpfile();
+    if (file && fwrite(text, 1, size, file) != size)
+    {
+        fclose(file);
+        file = NULL;
+    }
+#else
+    /* fmemopen() rejects an empty buffer, which is an empty sheet anyway */
+    FILE *file = (size > 0) ? fmemopen((void *) text, size, "r") : NULL;
+#endif
+
+    if (!file)
+    {
+        return sheet;
+    }
+
+    fseek(file, 0, SEEK_SET);
+    sheet = read_csv_stream(file, name);
     fclose(file);
     return sheet;
 }
@@ -101,18 +169,41 @@ write_csv (sheet_t *sheet,
     return 0;
 }
 
+/* SplitMix64, so that a seed shuffles the same way on every platform */
+static uint64_t
+shuffle_next (uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
 /* Indices are specific to `pairup` */
 void
 shuffle_worksheet (sheet_t *sheet,
-                   uint32_t seed)
+                   uint64_t seed)
 {
-    srand(seed);
-    for (int i = 1; i < sheet->rows - 1; ++i)
+    /* Member rows lie between the header and the last row */
+    int first = 1;
+    int n = sheet->rows - 2;
+    uint64_t state = seed;
+
+    /* Fisher-Yates, drawing below `i + 1` without modulo bias */
+    for (int i = n - 1; i > 0; --i)
     {
-        int j = (rand() % (sheet->rows - 2)) + 1;
-        char **temp = sheet->data[i];
-        sheet->data[i] = sheet->data[j];
-        sheet->data[j] = temp;
+        uint64_t bound = (uint64_t) i + 1;
+        uint64_t threshold = (0 - bound) % bound;
+        uint64_t r;
+        do
+        {
+            r = shuffle_next (&state);
+        } while (r < threshold);
+
+        int j = (int) (r % bound);
+        char **temp = sheet->data[first + i];
+        sheet->data[first + i] = sheet->data[first + j];
+        sheet->data[first + j] = temp;
     }
 }
 
@@ -19,13 +19,26 @@ typedef sheet_t sheet;
 sheet_t
 read_csv (const char *path);
 
+/*
+ * Like `read_csv`, but `data` is NULL instead of exiting on failure, and
+ * `path` is NULL as well if the file could not be opened
+ */
+sheet_t
+try_read_csv (const char *path);
+
+/* Parse CSV text held in memory, `data` is NULL on failure */
+sheet_t
+read_csv_buffer (const char *text,
+                 size_t size,
+                 const char *name);
+
 int
 write_csv (sheet_t *sheet,
            const char *path);
 
 void
 shuffle_worksheet (sheet_t *sheet,
-                   uint32_t seed);
+                   uint64_t seed);
 
 char *
 get_token (FILE *stream,
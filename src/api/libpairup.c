@@ -1,37 +1,521 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include "pairup/pairup-algorithm.h"
 #include "pairup/pairup-formatter.h"
+#include "pairup/pairup-pool.h"
+#include "pairup/pairup-random.h"
 #include "pairup/pairup-types.h"
 #include "rw-csv.h"
 #include "libpairup.h"
 #include "cJSON.h"
 
+#if defined(_WIN32) || defined(_WIN64)
+#define JOB_HAS_FD 0
+#define JOB_HAS_THREADS 0
+#else
+#define JOB_HAS_FD 1
+#define JOB_HAS_THREADS 1
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+#endif
+
+struct PairUP_Context {
+    PairUP_Allocator allocator;
+    struct pairup_log log;
+    pairup_random seeds;         // Seeds of calls without one, drawn atomically
+    int threads;                 // Workers of the batch pool (0: one per processor)
+    pairup_pool *pool;           // Created by the first batch, kept until destroyed
+};
+
+static void *default_allocate(void *user, size_t size) {
+    return malloc(size);
+}
+
+static void default_release(void *user, void *ptr) {
+    free(ptr);
+}
+
+/* Route the logs of this call to the context, until context_leave */
+static const struct pairup_log *context_enter(PairUP_Context *ctx) {
+    static const struct pairup_log silent = { DEBUG_NONE, NULL, NULL };
+    return pairup_log_swap(ctx ? &ctx->log : &silent);
+}
+
+static void context_leave(const struct pairup_log *previous) {
+    pairup_log_swap(previous);
+}
+
+PairUP_Context *PairUP_CreateContext(const PairUP_Allocator *allocator) {
+    PairUP_Allocator a = { default_allocate, default_release, NULL };
+    if (allocator != NULL && allocator->allocate != NULL && allocator->release != NULL)
+        a = *allocator;
+
+    PairUP_Context *ctx = (PairUP_Context *) a.allocate(a.user, sizeof(PairUP_Context));
+    if (ctx == NULL)
+        return NULL;
+
+    ctx->allocator = a;
+    ctx->log.level = DEBUG_NONE;
+    ctx->log.write = NULL;
+    ctx->log.user = NULL;
+    pairup_random_init(&ctx->seeds, 0, 0);
+    ctx->threads = 0;
+    ctx->pool = NULL;
+    return ctx;
+}
+
+void PairUP_DestroyContext(PairUP_Context *ctx) {
+    if (ctx != NULL) {
+        pairup_pool_free(ctx->pool);
+        ctx->allocator.release(ctx->allocator.user, ctx);
+    }
+}
+
+void PairUP_SetLogLevel(PairUP_Context *ctx, int level) {
+    ctx->log.level = level;
+}
+
+void PairUP_SetLogHandler(PairUP_Context *ctx, PairUP_LogFn handler, void *user) {
+    ctx->log.write = handler;
+    ctx->log.user = user;
+}
+
+void PairUP_SetSeed(PairUP_Context *ctx, uint64_t seed) {
+    pairup_random_init(&ctx->seeds, seed, 0);
+}
+
+void PairUP_SetThreads(PairUP_Context *ctx, int threads) {
+    ctx->threads = threads;
+}
+
 /* Read CSV source data */
-sheet PairUP_Read(const char *path) {
-    return read_csv(path);
+sheet PairUP_Read(PairUP_Context *ctx, const char *path) {
+    sheet worksheet = { NULL, 0, 0, NULL };
+    const struct pairup_log *previous = context_enter(ctx);
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        debug_printf(DEBUG_ERROR, "[ ERROR   ] Cannot open '%s'.\n", path);
+        context_leave(previous);
+        return worksheet;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *text = (size >= 0) ? (char *) malloc(size + 1) : NULL;
+    if (text != NULL) {
+        size_t n = fread(text, 1, size, file);
+        worksheet = read_csv_buffer(text, n, path);
+        free(text);
+    }
+    fclose(file);
+
+    context_leave(previous);
+    return worksheet;
 }
 
-void PairUP_DefaultOption(options *opt) {
+void PairUP_FreeSheet(PairUP_Context *ctx, sheet *worksheet) {
+    if (worksheet == NULL)
+        return;
+
+    for (int i = 0; worksheet->data != NULL && i < worksheet->rows; i++) {
+        for (int j = 0; j < worksheet->cols; j++)
+            free(worksheet->data[i][j]);
+        free(worksheet->data[i]);
+    }
+    free(worksheet->data);
+    free(worksheet->path);
+    worksheet->data = NULL;
+    worksheet->path = NULL;
+    worksheet->rows = worksheet->cols = 0;
+}
+
+void PairUP_DefaultOption(PairUP_Context *ctx, options *opt) {
     pairup_options_init (opt);
 }
 
-result *PairUP_Generate(sheet *worksheet, options *opt, uint32_t seed) {
+/* Point the row ids of `r`, found on the shuffled `view`, back at `original` */
+static void batch_restore_rows(result *r, const sheet *view, const sheet *original) {
+    member *seen[2 * MAX_MATCHES_LEN + MAX_MATCHES_LEN];
+    size_t count = 0;
+
+    for (size_t i = 0; i < r->pairs + r->singles; i++) {
+        member *m[2];
+        size_t k = 0;
+        if (i < r->pairs) {
+            m[k++] = r->pair_list[i]->a;
+            m[k++] = r->pair_list[i]->b;
+        } else {
+            m[k++] = r->single_list[i - r->pairs];
+        }
+
+        for (size_t j = 0; j < k; j++) {
+            bool known = false;
+            for (size_t s = 0; s < count && !known; s++)
+                known = (seen[s] == m[j]);
+            if (!known)
+                seen[count++] = m[j];
+        }
+    }
+
+    for (size_t s = 0; s < count; s++) {
+        int id = seen[s]->id;
+        for (int row = 0; row < original->rows; row++) {
+            if (original->data[row] == view->data[id]) {
+                seen[s]->id = row;
+                break;
+            }
+        }
+    }
+}
+
+/* Solve `original` under `x->seed` without touching it: the strings are */
+/* shared, the shuffled row order is private                            */
+static result *generate_private(sheet *original, options *x) {
+    sheet view = *original;
+    view.data = (char ***) malloc(original->rows * sizeof(char **));
+    if (view.data == NULL)
+        return NULL;
+    memcpy(view.data, original->data, original->rows * sizeof(char **));
+
+    shuffle_worksheet(&view, x->seed);
+    result *r = __pairup__ (&view, x);
+    if (r != NULL)
+        batch_restore_rows(r, &view, original);
+    free(view.data);
+    return r;
+}
+
+result *PairUP_Generate(PairUP_Context *ctx, sheet *worksheet, const options *opt, uint32_t seed) {
+    /* A private copy: the solvers may adjust it, and callers may share `opt` */
+    options x;
     if (opt == NULL)
-        PairUP_DefaultOption (opt);
+        PairUP_DefaultOption(ctx, &x);
+    else
+        x = *opt;
 
+    /* The same seed reproduces the same pairs */
     if (seed != 0)
-        shuffle_worksheet (worksheet, seed);
+        x.seed = seed;
+    else if (ctx != NULL)
+        x.seed = pairup_random_next_shared(&ctx->seeds);
+
+    /* Shuffled privately, so threads may share `worksheet` and the rows stay the caller's */
+    const struct pairup_log *previous = context_enter(ctx);
+    result *r;
+    if (seed != 0 || ctx != NULL)
+        r = generate_private(worksheet, &x);
+    else
+        r = __pairup__ (worksheet, &x);
+    context_leave(previous);
+    return r;
+}
+
+result *PairUP_Repair(PairUP_Context *ctx, sheet *worksheet, const options *opt, const cJSON *previous) {
+    options x;
+    if (opt == NULL)
+        PairUP_DefaultOption(ctx, &x);
+    else
+        x = *opt;
+
+    size_t count;
+    struct previous_pair *pairs = parse_result_json_pairs (previous, &count);
+    if (pairs == NULL)
+        return NULL;
 
-    return __pairup__ (worksheet, opt);
+    const struct pairup_log *saved = context_enter(ctx);
+    result *r = pairup_repair (worksheet, pairs, count, &x);
+    context_leave(saved);
+
+    free (pairs);
+    return r;
+}
+
+/* One sheet of a batch */
+struct batch_item {
+    sheet *worksheet;
+    options x;
+    result **slot;
+};
+
+static void batch_run(void *arg) {
+    struct batch_item *item = (struct batch_item *) arg;
+    *item->slot = generate_private(item->worksheet, &item->x);
 }
 
-cJSON *PairUP_ConvertToJSON(sheet *worksheet, result *result) {
-    return init_result_json_object (worksheet, result);
+/* The context's pool, created once even if batches start side by side */
+static pairup_pool *context_pool(PairUP_Context *ctx) {
+    pairup_pool *pool = pairup_atomic_load(&ctx->pool);
+    if (pool != NULL)
+        return pool;
+
+    pairup_pool *created = pairup_pool_new(ctx->threads);
+    if (created == NULL)
+        return NULL;
+
+    pool = NULL;
+    if (!pairup_atomic_cas(&ctx->pool, &pool, created)) {
+        pairup_pool_free(created);
+        return pool;
+    }
+    return created;
 }
 
-char *PairUP_ConvertToString(sheet *worksheet, result *result) {
-    cJSON *root = init_result_json_object(worksheet, result);
-    return get_result_json_string(root);
+size_t PairUP_GenerateBatch(PairUP_Context *ctx, sheet *const sheets[], size_t n,
+                            const options *opt, const uint32_t seeds[], result *results[]) {
+    struct batch_item *items = (struct batch_item *) calloc(n ? n : 1, sizeof(struct batch_item));
+    if (items == NULL || ctx == NULL) {
+        free(items);
+        return 0;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        items[i].worksheet = sheets[i];
+        items[i].slot = &results[i];
+        if (opt == NULL)
+            PairUP_DefaultOption(ctx, &items[i].x);
+        else
+            items[i].x = *opt;
+
+        /* Items run side by side, so each one is solved on a single thread */
+        items[i].x.jobs = 1;
+        items[i].x.seed = (seeds != NULL && seeds[i] != 0) ? seeds[i]
+                                                           : pairup_random_next_shared(&ctx->seeds);
+        results[i] = NULL;
+    }
+
+    const struct pairup_log *previous = context_enter(ctx);
+    pairup_pool *pool = (n > 1) ? context_pool(ctx) : NULL;
+    pairup_group group = PAIRUP_GROUP_INIT;
+
+    for (size_t i = 0; i < n; i++) {
+        if (sheets[i] == NULL || sheets[i]->data == NULL)
+            continue;
+        if (pool == NULL || !pairup_pool_submit_group(pool, &group, batch_run, &items[i]))
+            batch_run(&items[i]);
+    }
+    if (pool != NULL)
+        pairup_pool_wait_group(pool, &group);
+    context_leave(previous);
+
+    size_t produced = 0;
+    for (size_t i = 0; i < n; i++)
+        produced += (results[i] != NULL);
+
+    free(items);
+    return produced;
+}
+
+struct PairUP_Job {
+    PairUP_Context *ctx;
+    sheet *worksheet;
+    options x;
+    PairUP_Callback callback;
+    void *user;
+    int state;                   // PairUP_JobState, atomic
+    int cancel;                  // Set by PairUP_Cancel, atomic
+    int refs;                    // Caller and worker, atomic
+    result *result;
+    int fd[2];                   // Completion: read end, write end (-1: none)
+#if JOB_HAS_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t finished;     // Broadcast once the state is DONE or CANCELLED
+#endif
+};
+
+static void job_release(PairUP_Job *job) {
+    if (pairup_atomic_fetch_add(&job->refs, -1) != 1)
+        return;
+
+    free_pair_result(job->result);
+#if JOB_HAS_FD
+    if (job->fd[0] >= 0)
+        close(job->fd[0]);
+    if (job->fd[1] >= 0 && job->fd[1] != job->fd[0])
+        close(job->fd[1]);
+#endif
+#if JOB_HAS_THREADS
+    pthread_mutex_destroy(&job->lock);
+    pthread_cond_destroy(&job->finished);
+#endif
+    free(job);
+}
+
+static void job_open_fd(PairUP_Job *job) {
+    job->fd[0] = job->fd[1] = -1;
+#if JOB_HAS_FD && defined(__linux__)
+    job->fd[0] = job->fd[1] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+#elif JOB_HAS_FD
+    if (pipe(job->fd) != 0)
+        job->fd[0] = job->fd[1] = -1;
+#endif
+}
+
+/* Wake PairUP_JobWait and make the descriptor readable for good: nobody reads from it */
+static void job_signal_fd(PairUP_Job *job) {
+#if JOB_HAS_THREADS
+    pthread_mutex_lock(&job->lock);
+    pthread_cond_broadcast(&job->finished);
+    pthread_mutex_unlock(&job->lock);
+#endif
+#if JOB_HAS_FD
+    if (job->fd[1] >= 0) {
+#if defined(__linux__)
+        uint64_t one = 1;
+        while (write(job->fd[1], &one, sizeof(one)) < 0 && errno == EINTR)
+            ;
+#else
+        char one = 1;
+        while (write(job->fd[1], &one, 1) < 0 && errno == EINTR)
+            ;
+#endif
+    }
+#endif
+}
+
+static void job_run(void *arg) {
+    PairUP_Job *job = (PairUP_Job *) arg;
+    int queued = PAIRUP_JOB_QUEUED;
+
+    if (pairup_atomic_cas(&job->state, &queued, PAIRUP_JOB_RUNNING)) {
+        job->result = generate_private(job->worksheet, &job->x);
+        pairup_atomic_store(&job->state, PAIRUP_JOB_DONE);
+    }
+
+    job_signal_fd(job);
+    if (job->callback != NULL)
+        job->callback(job, job->user);
+    job_release(job);
+}
+
+PairUP_Job *PairUP_Submit(PairUP_Context *ctx, sheet *worksheet, const options *opt, uint32_t seed,
+                          PairUP_Callback callback, void *user) {
+    if (ctx == NULL || worksheet == NULL || worksheet->data == NULL)
+        return NULL;
+
+    PairUP_Job *job = (PairUP_Job *) calloc(1, sizeof(PairUP_Job));
+    if (job == NULL)
+        return NULL;
+
+    job->ctx = ctx;
+    job->worksheet = worksheet;
+    if (opt == NULL)
+        PairUP_DefaultOption(ctx, &job->x);
+    else
+        job->x = *opt;
+    /* Jobs run side by side on the context pool, so each one uses a single thread */
+    job->x.jobs = 1;
+    job->x.seed = (seed != 0) ? seed : pairup_random_next_shared(&ctx->seeds);
+    job->x.cancel = &job->cancel;
+    job->callback = callback;
+    job->user = user;
+    job->state = PAIRUP_JOB_QUEUED;
+    job->refs = 2;
+#if JOB_HAS_THREADS
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->finished, NULL);
+#endif
+    job_open_fd(job);
+
+    const struct pairup_log *previous = context_enter(ctx);
+    pairup_pool *pool = context_pool(ctx);
+    if (pool == NULL || !pairup_pool_submit(pool, job_run, job))
+        job_run(job);
+    context_leave(previous);
+
+    return job;
+}
+
+int PairUP_JobFd(PairUP_Job *job) {
+    return job->fd[0];
+}
+
+PairUP_JobState PairUP_JobStatus(PairUP_Job *job) {
+    return (PairUP_JobState) pairup_atomic_load(&job->state);
+}
+
+PairUP_JobState PairUP_JobWait(PairUP_Job *job) {
+#if JOB_HAS_THREADS
+    pthread_mutex_lock(&job->lock);
+    while (PairUP_JobStatus(job) < PAIRUP_JOB_DONE)
+        pthread_cond_wait(&job->finished, &job->lock);
+    pthread_mutex_unlock(&job->lock);
+#endif
+    /* Without pthreads the job ran inline in PairUP_Submit */
+    return PairUP_JobStatus(job);
+}
+
+result *PairUP_JobResult(PairUP_Job *job) {
+    if (PairUP_JobStatus(job) != PAIRUP_JOB_DONE)
+        return NULL;
+
+    result *r = job->result;
+    job->result = NULL;
+    return r;
+}
+
+bool PairUP_Cancel(PairUP_Job *job) {
+    int queued = PAIRUP_JOB_QUEUED;
+    pairup_atomic_store(&job->cancel, 1);
+    if (!pairup_atomic_cas(&job->state, &queued, PAIRUP_JOB_CANCELLED))
+        return false;
+
+    job_signal_fd(job);
+    return true;
+}
+
+void PairUP_JobFree(PairUP_Job *job) {
+    if (job == NULL)
+        return;
+
+    PairUP_Cancel(job);
+    job_release(job);
+}
+
+void PairUP_FreeResult(PairUP_Context *ctx, result *result) {
+    free_pair_result(result);
+}
+
+cJSON *PairUP_ConvertToJSON(PairUP_Context *ctx, sheet *worksheet, result *result) {
+    const struct pairup_log *previous = context_enter(ctx);
+    cJSON *root = init_result_json_object (worksheet, result);
+    context_leave(previous);
+    return root;
+}
+
+void PairUP_FreeJSONObject(PairUP_Context *ctx, cJSON *root) {
+    free_result_json_object(root);
+}
+
+char *PairUP_ConvertToString(PairUP_Context *ctx, sheet *worksheet, result *result) {
+    const struct pairup_log *previous = context_enter(ctx);
+    char *text = NULL;
+    if (ctx == NULL) {
+        text = new_result_json_string(worksheet, result);
+    } else {
+        /* Written straight into memory of the caller's allocator */
+        size_t size = snprint_result_json(NULL, 0, worksheet, result) + 1;
+        text = (char *) ctx->allocator.allocate(ctx->allocator.user, size);
+        if (text != NULL)
+            snprint_result_json(text, size, worksheet, result);
+    }
+    context_leave(previous);
+    return text;
+}
 
+void PairUP_FreeJSONString(PairUP_Context *ctx, char *str) {
+    if (str == NULL)
+        return;
+    if (ctx == NULL)
+        free_result_json_string(str);
+    else
+        ctx->allocator.release(ctx->allocator.user, str);
 }
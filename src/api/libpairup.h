@@ -19,19 +19,109 @@ typedef sheet_t sheet;
 typedef result_t result;
 typedef struct pairup_options options;
 
-#define PairUP_FreeJSONObject free_result_json_object
-#define PairUP_FreeJSONString free_result_json_string
+/* Everything a caller of the library owns: log, random seeds and allocator. */
+/* Calls on different contexts never share state, and calls on one context  */
+/* may run on several threads once it is configured.                        */
+typedef struct PairUP_Context PairUP_Context;
 
-/* Read CSV source data */
-sheet PairUP_Read(const char *path);
+/* Memory handed out by the library: contexts and strings */
+typedef struct PairUP_Allocator {
+    void *(*allocate)(void *user, size_t size);
+    void (*release)(void *user, void *ptr);
+    void *user;
+} PairUP_Allocator;
 
-void PairUP_DefaultOption (options *opt);
+/* Receives each log line with its level (DEBUG_ERROR ... DEBUG_ALL) */
+typedef pairup_log_fn PairUP_LogFn;
 
-result *PairUP_Generate(sheet *worksheet, options *opt, uint32_t seed);
+/* NULL allocator: malloc and free. Logs are off and the seed is 0 */
+PairUP_Context *PairUP_CreateContext(const PairUP_Allocator *allocator);
 
-cJSON *PairUP_ConvertToJSON(sheet *worksheet, result *result);
+void PairUP_DestroyContext(PairUP_Context *ctx);
 
-char *PairUP_ConvertToString(sheet *worksheet, result *result);
+void PairUP_SetLogLevel(PairUP_Context *ctx, int level);
+
+/* NULL handler: print to stdout */
+void PairUP_SetLogHandler(PairUP_Context *ctx, PairUP_LogFn handler, void *user);
+
+/* Seeds drawn for PairUP_Generate calls without a seed of their own */
+void PairUP_SetSeed(PairUP_Context *ctx, uint64_t seed);
+
+/* Workers of PairUP_GenerateBatch, 0: one per processor (the default) */
+void PairUP_SetThreads(PairUP_Context *ctx, int threads);
+
+/* Read CSV source data, `data` is NULL if the file cannot be read */
+sheet PairUP_Read(PairUP_Context *ctx, const char *path);
+
+void PairUP_FreeSheet(PairUP_Context *ctx, sheet *worksheet);
+
+void PairUP_DefaultOption(PairUP_Context *ctx, options *opt);
+
+/* `seed` 0 draws the next seed of the context; `worksheet` and `opt` are only read */
+result *PairUP_Generate(PairUP_Context *ctx, sheet *worksheet, const options *opt, uint32_t seed);
+
+/* Keep the pairs of `previous` (a result from PairUP_ConvertToJSON) that */
+/* still fit the edited worksheet, and only pair up the freed requests   */
+result *PairUP_Repair(PairUP_Context *ctx, sheet *worksheet, const options *opt, const cJSON *previous);
+
+/* Pair up `n` sheets on the context's worker pool, which is kept between    */
+/* calls. `results[i]` belongs to `sheets[i]` (which may repeat one sheet to */
+/* try many seeds) and `seeds[i]` (NULL or 0: drawn in input order), so the  */
+/* results never depend on the number of workers. The sheets are not        */
+/* modified, and each result refers to the rows of its unshuffled sheet.    */
+/* Returns the number of results, NULL results count as failures.           */
+size_t PairUP_GenerateBatch(PairUP_Context *ctx, sheet *const sheets[], size_t n,
+                            const options *opt, const uint32_t seeds[], result *results[]);
+
+/* A PairUP_Generate running on the context's worker pool */
+typedef struct PairUP_Job PairUP_Job;
+
+typedef enum PairUP_JobState {
+    PAIRUP_JOB_QUEUED,
+    PAIRUP_JOB_RUNNING,
+    PAIRUP_JOB_DONE,
+    PAIRUP_JOB_CANCELLED         // Cancelled before it started, no result
+} PairUP_JobState;
+
+/* Runs on the worker thread once the job is over, whether done or cancelled */
+typedef void (*PairUP_Callback)(PairUP_Job *job, void *user);
+
+/* Start pairing up `worksheet` (kept alive and unmodified until the job is */
+/* over) and return at once. `callback` may be NULL. NULL on failure        */
+PairUP_Job *PairUP_Submit(PairUP_Context *ctx, sheet *worksheet, const options *opt, uint32_t seed,
+                          PairUP_Callback callback, void *user);
+
+/* A descriptor that turns readable, and stays readable, once the job is */
+/* over: poll it from an event loop. -1 where there is none              */
+int PairUP_JobFd(PairUP_Job *job);
+
+PairUP_JobState PairUP_JobStatus(PairUP_Job *job);
+
+/* Block until the job is over */
+PairUP_JobState PairUP_JobWait(PairUP_Job *job);
+
+/* The result of a finished job, which the caller then owns (NULL otherwise) */
+result *PairUP_JobResult(PairUP_Job *job);
+
+/* True if the job had not started and never will; a running job stops at */
+/* the solvers' next check and is done with its best result so far, which */
+/* is marked `partial`                                                     */
+bool PairUP_Cancel(PairUP_Job *job);
+
+/* Drop the handle, cancelling the job if it is still queued. Safe to call */
+/* from the callback; the job's memory goes once the worker is done too   */
+void PairUP_JobFree(PairUP_Job *job);
+
+void PairUP_FreeResult(PairUP_Context *ctx, result *result);
+
+cJSON *PairUP_ConvertToJSON(PairUP_Context *ctx, sheet *worksheet, result *result);
+
+void PairUP_FreeJSONObject(PairUP_Context *ctx, cJSON *root);
+
+/* Allocated with the context's allocator, free with PairUP_FreeJSONString */
+char *PairUP_ConvertToString(PairUP_Context *ctx, sheet *worksheet, result *result);
+
+void PairUP_FreeJSONString(PairUP_Context *ctx, char *str);
 
 #ifdef __cplusplus
 }
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <limits.h>
 #include <time.h>
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -12,6 +13,11 @@
 #endif
 
 #include "pairup/pairup.h"
+#include "pairup/pairup-batch.h"
+#include "pairup/pairup-cache.h"
+#include "pairup/pairup-server.h"
+#include "pairup/pairup-svg.h"
+#include "pairup/pairup-watch.h"
 #include "version.h"
 #include "rw-csv.h"
 
@@ -39,21 +45,48 @@ Usage: %s [OPTION]... SOURCE_CSV\n\
 Generate optimal matches based on member's available time with linear time complexity\n\n\
 Options:\n\
   -s, --show-csv              show the csv data only (no pair result)\n\
-  -g, --graph={OUTPUT}        generate the relation graph\n\
+  -g, --graph={OUTPUT}        draw the relation graph with today's pairs (default:\n\
+                              relations.svg); other formats need Graphviz\n\
   -e, --ensure={MEMBER}       ensure specified member can have partner today\n\
   -j, --json-output           print structural output(JSON)\n\
   -d, --debug={LEVEL}         set the debug level (0: only error, 5: all info)\n\
-  -p, --priority={FUNC}       specify the match priority algorithm\n\
+  -p, --priority={FUNC}       specify the match priority algorithm, or keys like\n\
+                              'availability:asc,requests:desc,earliest' to sort by\n\
+      --exact-nodes={N}       search nodes the OPTIMAL priority may expand\n\
+      --exact-ms={N}          time budget of the OPTIMAL priority in milliseconds\n\
+      --local-iters={N}       moves the LOCAL_SEARCH priority may try\n\
+      --local-ms={N}          time budget of the LOCAL_SEARCH priority in milliseconds\n\
+      --no-augment            keep the priority result without re-pairing singles\n\
+      --jobs={N}              evaluate priorities on N threads (0: one per CPU)\n\
+      --time-budget-ms={N}    keep trying random orders for N milliseconds\n\
+      --seeds={K}             try K random orders (with or without a time budget)\n\
+      --stream                report every improvement of the random orders on stderr\n\
+      --seed={N}              seed every random choice (the same seed gives the same pairs)\n\
+      --deadline-ms={N}       stop every solver after N milliseconds and print the\n\
+                              best result so far (marked partial)\n\
+      --previous={JSON}       repair an earlier JSON result instead of starting over\n\
+      --no-cache              always solve, even if this sheet was solved before\n\
+      --cache-dir={DIR}       keep results in DIR (default: ~/.cache/pairup)\n\
+      --serve={SOCKET}        answer length-prefixed requests on a Unix socket\n\
+      --http={HOST:PORT}      serve POST /pair, POST /graph and GET /metrics\n\
+      --watch={DIR}           pair up every CSV file in DIR again whenever it changes\n\
+      --output={PATH}         where --watch puts results: a directory (default: DIR)\n\
+                              or a Unix socket\n\
+      --ndjson                pair up every SOURCE_CSV and print one compact JSON\n\
+                              line per result as soon as it is ready\n\
+      --runs={N}              with --ndjson, pair up each sheet N times with\n\
+                              consecutive seeds (default: 1)\n\
   -v, --version               print the version information\n\
   -h, --help                  print this page\n\n\
 Examples:\n\
   %s '英文讀書會時間 Ver.4.csv'              # display the optimal matches\n\
   %s -s '英文讀書會時間 Ver.4.csv'           # show the csv data only\n\
-  %s -g '英文讀書會時間 Ver.4.csv'           # generate 'relations.png' pairing graph\n\
+  %s -g '英文讀書會時間 Ver.4.csv'           # generate 'relations.svg' pairing graph\n\
   %s -p LAST_ROW '英文讀書會時間 Ver.4.csv'  # match member from the last row\n\
-  %s -e 'Bob' '英文讀書會時間 Ver.4.csv'     # match Bob first\n\n\
+  %s -e 'Bob' '英文讀書會時間 Ver.4.csv'     # match Bob first\n\
+  %s --previous=today.json '英文讀書會時間 Ver.4.csv'  # keep today's pairs that still fit\n\n\
 For more information, see <https://github.com/jackiesogi/pairup.c>.\n\
-", program_name, program_name, program_name, program_name, program_name, program_name);
+", program_name, program_name, program_name, program_name, program_name, program_name, program_name);
     }
     exit (status);
 }
@@ -61,11 +94,63 @@ For more information, see <https://github.com/jackiesogi/pairup.c>.\n\
 bool
 has_installed_graphviz ()
 {
-    if (system("which dot > /dev/null") == 0)
+#if defined(_WIN32) || defined(_WIN64)
+    if (system("where dot > NUL 2>&1") == 0)
         return true;
     return false;
+#else
+    /* Look through $PATH ourselves instead of starting a shell for `which` */
+    const char *path = getenv ("PATH");
+    char candidate[4096];
+
+    while (path && *path)
+    {
+        const char *end = strchr (path, ':');
+        size_t length = end ? (size_t) (end - path) : strlen (path);
+
+        snprintf (candidate, sizeof(candidate), "%.*s/dot", (int) length, length ? path : ".");
+        if (access (candidate, X_OK) == 0)
+            return true;
+
+        path = end ? end + 1 : NULL;
+    }
+    return false;
+#endif
 }
 
+/* Whether `filename` asks for the built-in SVG renderer */
+bool
+is_svg_output (const char *filename)
+{
+    size_t n = strlen (filename);
+    return n >= 4 && strcmp (filename + n - 4, ".svg") == 0;
+}
+
+/* For long options that have no equivalent short option */
+enum
+{
+    EXACT_NODES_OPTION = CHAR_MAX + 1,
+    EXACT_MS_OPTION,
+    LOCAL_ITERS_OPTION,
+    LOCAL_MS_OPTION,
+    NO_AUGMENT_OPTION,
+    JOBS_OPTION,
+    TIME_BUDGET_OPTION,
+    SEEDS_OPTION,
+    STREAM_OPTION,
+    SEED_OPTION,
+    DEADLINE_OPTION,
+    PREVIOUS_OPTION,
+    NO_CACHE_OPTION,
+    CACHE_DIR_OPTION,
+    SERVE_OPTION,
+    HTTP_OPTION,
+    WATCH_OPTION,
+    OUTPUT_OPTION,
+    NDJSON_OPTION,
+    RUNS_OPTION
+};
+
 static char const short_options[] = "d:sg::e:jp:vh";
 
 static struct option const long_options[] =
@@ -76,6 +161,26 @@ static struct option const long_options[] =
     {"ensure", required_argument, NULL, 'e'},
     {"json-output", no_argument, NULL, 'j'},
     {"debug", required_argument, NULL, 'd'},
+    {"exact-nodes", required_argument, NULL, EXACT_NODES_OPTION},
+    {"exact-ms", required_argument, NULL, EXACT_MS_OPTION},
+    {"local-iters", required_argument, NULL, LOCAL_ITERS_OPTION},
+    {"local-ms", required_argument, NULL, LOCAL_MS_OPTION},
+    {"no-augment", no_argument, NULL, NO_AUGMENT_OPTION},
+    {"jobs", required_argument, NULL, JOBS_OPTION},
+    {"time-budget-ms", required_argument, NULL, TIME_BUDGET_OPTION},
+    {"seeds", required_argument, NULL, SEEDS_OPTION},
+    {"stream", no_argument, NULL, STREAM_OPTION},
+    {"seed", required_argument, NULL, SEED_OPTION},
+    {"deadline-ms", required_argument, NULL, DEADLINE_OPTION},
+    {"previous", required_argument, NULL, PREVIOUS_OPTION},
+    {"no-cache", no_argument, NULL, NO_CACHE_OPTION},
+    {"cache-dir", required_argument, NULL, CACHE_DIR_OPTION},
+    {"serve", required_argument, NULL, SERVE_OPTION},
+    {"http", required_argument, NULL, HTTP_OPTION},
+    {"watch", required_argument, NULL, WATCH_OPTION},
+    {"output", required_argument, NULL, OUTPUT_OPTION},
+    {"ndjson", no_argument, NULL, NDJSON_OPTION},
+    {"runs", required_argument, NULL, RUNS_OPTION},
     {"version", no_argument, NULL, 'v'},
     {"help", no_argument, NULL, 'h'},
     {NULL, 0, NULL, 0}
@@ -146,6 +251,68 @@ parse_debug_level (const char *str)
     }
 }
 
+/* Pairs of a result printed by `pairup -j`, NULL on failure */
+struct previous_pair *
+read_previous_result (const char *path,
+                      size_t *count)
+{
+    FILE *file = fopen (path, "rb");
+    if (!file)
+    {
+        fprintf (stderr, "%s: cannot open '%s'\n", program_name, path);
+        return NULL;
+    }
+
+    fseek (file, 0, SEEK_END);
+    long size = ftell (file);
+    fseek (file, 0, SEEK_SET);
+
+    char *text = (char *) malloc (size + 1);
+    if (!text)
+    {
+        fclose (file);
+        return NULL;
+    }
+    size_t n = fread (text, 1, size, file);
+    text[n] = '\0';
+    fclose (file);
+
+    cJSON *root = cJSON_Parse (text);
+    free (text);
+
+    struct previous_pair *previous = parse_result_json_pairs (root, count);
+    cJSON_Delete (root);
+
+    if (!previous)
+    {
+        fprintf (stderr, "%s: '%s' is not a JSON result of %s\n", program_name, path, program_name);
+    }
+    return previous;
+}
+
+/* Copy a cached result to stdout, false on a miss */
+bool
+print_cached_result (const char *dir,
+                     uint64_t key,
+                     const char *ext)
+{
+    FILE *entry = pairup_cache_open (dir, key, ext);
+    if (!entry)
+    {
+        return false;
+    }
+
+    char buffer[4096];
+    size_t n;
+    while ((n = fread (buffer, 1, sizeof(buffer), entry)) > 0)
+    {
+        fwrite (buffer, 1, n, stdout);
+    }
+    fclose (entry);
+
+    return true;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -159,6 +326,13 @@ main (int argc, char *argv[])
     pairup_options_init (&x);
     char graph_output[1024];
     struct user_defined_ensure_list elist;
+    const char *previous_path = NULL;
+    const char *serve_path = NULL;
+    const char *http_address = NULL;
+    const char *watch_dir = NULL;
+    const char *output_path = NULL;
+    bool ndjson = false;
+    size_t runs = 1;
 
     /* Parse the command line arguments using while loop */
     int c;
@@ -171,16 +345,18 @@ main (int argc, char *argv[])
                 x.debug_level = debug_level;
                 break;
             case 'g':
-                if (!has_installed_graphviz())
-                {
-                    debug_printf (DEBUG_ERROR, "[ ERROR   ] Please install package `graphviz` first\n");
-                    exit (EXIT_FAILURE);
-                }
                 x.generate_graph = true;
                 if (optarg)
                     strcpy (graph_output, (const char *)optarg);
                 else
-                    strcpy (graph_output, "relations.png");
+                    strcpy (graph_output, "relations.svg");
+                if (!is_svg_output (graph_output) && !has_installed_graphviz())
+                {
+                    fprintf (stderr, "%s: drawing '%s' needs package `graphviz`, "
+                             "install it or draw an SVG file (-grelations.svg)\n",
+                             program_name, graph_output);
+                    exit (EXIT_FAILURE);
+                }
                 break;
             case 's':
                 x.show_csv = true;
@@ -196,6 +372,72 @@ main (int argc, char *argv[])
                 x.priority = true;
                 strncpy(x.priority_func, optarg, 1024);
                 break;
+            case EXACT_NODES_OPTION:
+                x.exact_node_limit = strtoul (optarg, NULL, 10);
+                x.exact_budget_given = true;
+                break;
+            case EXACT_MS_OPTION:
+                x.exact_time_limit_ms = atoi (optarg);
+                x.exact_budget_given = true;
+                break;
+            case LOCAL_ITERS_OPTION:
+                x.local_iterations = strtoul (optarg, NULL, 10);
+                x.local_budget_given = true;
+                break;
+            case LOCAL_MS_OPTION:
+                x.local_time_limit_ms = atoi (optarg);
+                x.local_budget_given = true;
+                break;
+            case NO_AUGMENT_OPTION:
+                x.augment = false;
+                break;
+            case JOBS_OPTION:
+                x.jobs = atoi (optarg);
+                break;
+            case TIME_BUDGET_OPTION:
+                x.time_budget_ms = atoi (optarg);
+                break;
+            case SEEDS_OPTION:
+                x.seeds = strtoul (optarg, NULL, 10);
+                break;
+            case STREAM_OPTION:
+                x.stream = true;
+                break;
+            case SEED_OPTION:
+                x.seed = strtoull (optarg, NULL, 10);
+                x.seeded = true;
+                break;
+            case DEADLINE_OPTION:
+                x.deadline_ms = atoi (optarg);
+                break;
+            case PREVIOUS_OPTION:
+                previous_path = optarg;
+                break;
+            case NO_CACHE_OPTION:
+                x.cache = false;
+                break;
+            case SERVE_OPTION:
+                serve_path = optarg;
+                break;
+            case HTTP_OPTION:
+                http_address = optarg;
+                break;
+            case WATCH_OPTION:
+                watch_dir = optarg;
+                break;
+            case OUTPUT_OPTION:
+                output_path = optarg;
+                break;
+            case NDJSON_OPTION:
+                ndjson = true;
+                break;
+            case RUNS_OPTION:
+                runs = strtoul (optarg, NULL, 10);
+                break;
+            case CACHE_DIR_OPTION:
+                strncpy (x.cache_dir, optarg, sizeof(x.cache_dir) - 1);
+                x.cache_dir[sizeof(x.cache_dir) - 1] = '\0';
+                break;
             case 'v':
                 printf ("%s\n", PROGRAM_VERSION);
                 return 0;
@@ -210,55 +452,148 @@ main (int argc, char *argv[])
         }
     }
 
+    /* A server reads its sheets from the socket (or directory), not from the command line */
+    if (serve_path)
+    {
+        return pairup_serve_unix (serve_path, &x, PROGRAM_VERSION);
+    }
+    if (http_address)
+    {
+        return pairup_serve_http (http_address, &x, PROGRAM_VERSION);
+    }
+    if (watch_dir)
+    {
+        if (x.ensure == true)
+        {
+            x.ensure_member_list = &elist;
+        }
+        return pairup_watch (watch_dir, output_path, &x, PROGRAM_VERSION);
+    }
+
     if (optind >= argc)
     {
         fprintf (stderr, "%s: missing operand\n", program_name);
         exit (EXIT_FAILURE);
     }
 
+    /* Every operand is a sheet, and results are never cached: each run is timed */
+    if (ndjson)
+    {
+        if (x.ensure == true)
+        {
+            x.ensure_member_list = &elist;
+        }
+        return pairup_run_ndjson (&argv[optind], argc - optind, runs > 0 ? runs : 1,
+                                  &x, PROGRAM_VERSION, stdout);
+    }
+
     /* Additional non-option arguments is the input file */
     char *path = argv[optind];
 
     /* Read the csv file */
     sheet_t worksheet = read_csv (path);
 
-    if (x.generate_graph)
+    if (x.ensure == true)
+    {
+        x.ensure_member_list = &elist;
+    }
+    if (x.generate_graph && !is_svg_output (graph_output))
     {
         generate_graph_output_image (&worksheet, graph_output);
         return 0;
     }
+    if (x.generate_graph)
+    {
+        /* The built-in renderer also shows who is paired up with whom */
+        if (!x.seeded)
+        {
+            x.seed = (uint64_t) time (NULL);
+        }
+        debug_printf(DEBUG_SUMMARY, "[ SUMMARY ] Seed: %llu\n", (unsigned long long) x.seed);
+
+        shuffle_worksheet (&worksheet, x.seed);
+        pair_result_t *result = __pairup__ (&worksheet, &x);
+        generate_graph_output_svg (&worksheet, result, graph_output);
+        free_pair_result (result);
+        return 0;
+    }
     if (x.show_csv)
     {
         print_worksheet (&worksheet);
         return 0;
     }
-    if (x.ensure == true)
+
+    /*
+     * A repeated run prints the cached result. Only runs that are a function
+     * of the sheet and options are cached: without --seed the seed is taken
+     * from the key, and a time budget makes the result depend on the clock.
+     * A result cut short by --deadline-ms is printed but never cached, and
+     * neither is one the exact or local search left below the bound when
+     * its budget ran out, as more time or fewer --jobs may do better.
+     */
+    char cache_dir[1024];
+    uint64_t cache_key = 0;
+    bool cached = x.cache && !previous_path && x.time_budget_ms == 0 &&
+                  pairup_cache_dir (x.cache_dir, cache_dir, sizeof(cache_dir));
+    const char *cache_ext = x.json_output ? "json" : "txt";
+
+    if (cached)
     {
-        x.ensure_member_list = &elist;
+        cache_key = pairup_cache_key (&worksheet, &x, PROGRAM_VERSION);
+        if (print_cached_result (cache_dir, cache_key, cache_ext))
+        {
+            debug_printf(DEBUG_SUMMARY, "[ SUMMARY ] Cache hit: %016llx\n", (unsigned long long) cache_key);
+            return 0;
+        }
     }
 
-    /* Randomize the worksheet rows to avoid bias */
-    debug_printf(DEBUG_INFO, "\
-[ INFO    ] Shuffling each row inside the input worksheet to avoid bias result ...\n");
-    shuffle_worksheet (&worksheet, time(NULL));
-    debug_printf(DEBUG_INFO, "[ INFO    ] Finished shuffling.\n");
-
-    /* Trigger the top-level pairup function */
-    debug_printf(DEBUG_INFO, "[ INFO    ] Starting the pairing up process ...\n");
-    pair_result_t *result = __pairup__ (&worksheet, &x);
+    /* Report the seed, so that any run can be reproduced with --seed */
+    if (!x.seeded)
+    {
+        x.seed = cached ? cache_key : (uint64_t) time (NULL);
+    }
+    debug_printf(DEBUG_SUMMARY, "[ SUMMARY ] Seed: %llu\n", (unsigned long long) x.seed);
 
-    /* Print the result */
-    if (x.json_output == true)
+    pair_result_t *result = NULL;
+    if (previous_path)
     {
-        cJSON *root = init_result_json_object (&worksheet, result);
-        char *json_output = get_result_json_string (root);
-        fprintf (stdout, "%s\n", json_output);
-        free_result_json_object (root);
-        free_result_json_string (json_output);
+        /* Keep the rows in sheet order, so the same edit repairs the same way */
+        size_t count;
+        struct previous_pair *previous = read_previous_result (previous_path, &count);
+        if (!previous)
+        {
+            exit (EXIT_FAILURE);
+        }
+
+        debug_printf(DEBUG_INFO, "[ INFO    ] Repairing %zu previous pairs ...\n", count);
+        result = pairup_repair (&worksheet, previous, count, &x);
+        free (previous);
     }
     else
     {
-        print_result (&worksheet, result);
+        /* Randomize the worksheet rows to avoid bias */
+        debug_printf(DEBUG_INFO, "\
+[ INFO    ] Shuffling each row inside the input worksheet to avoid bias result ...\n");
+        shuffle_worksheet (&worksheet, x.seed);
+        debug_printf(DEBUG_INFO, "[ INFO    ] Finished shuffling.\n");
+
+        /* Trigger the top-level pairup function */
+        debug_printf(DEBUG_INFO, "[ INFO    ] Starting the pairing up process ...\n");
+        result = __pairup__ (&worksheet, &x);
+    }
+
+    /* Print the result */
+    write_result (stdout, &worksheet, result, x.json_output);
+
+    if (cached && !result->partial && !result->unsettled)
+    {
+        char tmp_path[2048];
+        FILE *entry = pairup_cache_create (cache_dir, cache_key, cache_ext, tmp_path, sizeof(tmp_path));
+        if (entry)
+        {
+            write_result (entry, &worksheet, result, x.json_output);
+            pairup_cache_commit (entry, cache_dir, cache_key, cache_ext, tmp_path);
+        }
     }
 
     free_pair_result (result);
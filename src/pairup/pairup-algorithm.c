@@ -1,17 +1,22 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
 #include "pairup-algorithm.h"
 #include "pairup-types.h"
 #include "pairup-formatter.h"
+#include "pairup-matching.h"
+#include "pairup-multistart.h"
+#include "pairup-pool.h"
+#include "pairup-priority.h"
+#include "pairup-random.h"
 #include "rw-csv.h"
 
 /* Pairup algorithm (internal) */
 typedef pair_result *
 (*pairup_internal) (relation_graph *today,
-                    member_t *member_list[]);
+                    member_t *member_list[],
+                    struct pairup_options *x);
 
 typedef struct pairup_algorithm pairup_algorithm_t;
 typedef struct pairup_algorithm pairup_algorithm;  // Recommended
@@ -62,6 +67,14 @@ const pairup_algorithm a[] = {                    // WHO WILL BE PAIRED UP FIRST
         "MOST_REQUEST_PRIORITY",                  // Members with 'two' requests.
         pairup_most_request_priority
     },
+    {
+        "OPTIMAL",                                // Maximum matching, regardless of order.
+        pairup_optimal_priority
+    },
+    {
+        "LOCAL_SEARCH",                           // Greedy start improved by simulated annealing.
+        pairup_local_search_priority
+    },
     {
         NULL,                                     // Terminating condition
         NULL
@@ -69,7 +82,6 @@ const pairup_algorithm a[] = {                    // WHO WILL BE PAIRED UP FIRST
 };
 
 /********************  INTERNAL FUNCTIONS DECLARATION (START)  *********************/
-/* Generate a random integer, only for internal use */
 static int
 preprocess_fixed_memblist (sheet *worksheet,
                            member *mlist[],
@@ -80,9 +92,6 @@ preprocess_relation_graph (sheet *worksheet,
                            graph *today,
                            member *mlist[]);
 
-static int
-get_random_int (void);
-
 static int
 get_member_availability (sheet *worksheet,
                          int id);
@@ -91,6 +100,10 @@ static int
 get_member_earliest_slot (sheet *worksheet,
                           int id);
 
+static slot_mask
+get_member_slots (sheet *worksheet,
+                  int id);
+
 static int
 get_member_requests (sheet *worksheet,
                      int id);
@@ -99,68 +112,19 @@ static char *
 get_member_name (sheet *worksheet,
                  int id);
 
-static
-pairup_internal
+static int
 get_algorithm_by_name (const char *target)
 {
     for (int i = 0; a[i].algorithm != NULL; i++)
     {
         if (strncmp(a[i].name, target, 1024) == 0)
         {
-            return a[i].algorithm;
+            return i;
         }
     }
-    return NULL;
+    return -1;
 }
 
-pair_result *
-pairup_ensure_list_priority (graph *graph,
-                             member *members[]);
-
-static int
-compare_availability_asc (const void *a,
-                          const void *b);
-
-static int
-compare_availability_desc (const void *a,
-                           const void *b);
-
-static int
-compare_row_count_asc (const void *a,
-                       const void *b);
-
-static int
-compare_row_count_desc (const void *a,
-                        const void *b);
-
-static int
-compare_id_asc (const void *a,
-                const void *b);
-
-static int
-compare_id_desc (const void *a,
-                 const void *b);
-
-static int
-compare_requests_asc (const void *a,
-                      const void *b);
-
-static int
-compare_requests_desc (const void *a,
-                       const void *b);
-
-static int
-compare_earliest_slot_asc (const void *a,
-                           const void *b);
-
-static int
-compare_earliest_slot_desc (const void *a,
-                            const void *b);
-
-static int
-compare_ensure_list (const void *a,
-                     const void *b);
-
 static int
 find_member_id (graph *today,
                 member *member);
@@ -188,153 +152,140 @@ pairup_bfs (graph *today,
 static pair_result *
 pairup_with_priority (graph *today,
                       member *members[],
-                      int (*compare_fn)(const void *, const void *));
+                      const struct priority_expr *expr);
+
+static pair_result *
+pairup_with_expression (graph *today,
+                        member *members[],
+                        const char *expression);
 
 /*******************  INTERNAL FUNCTIONS DECLARATION (END)  ***********************/
 
+/* When each single is available, so printers need not go back to the sheet */
 static void
-append_range_string (sheet_t *worksheet,
-                      int start_col,
-                      int end_col,
-                      char *out,
-                      size_t out_size)
+collect_single_ranges (pair_result *result)
 {
-    /* Merge consecutive 30-min slots into one string like 1900~2400 */
-    char *start_label = get_time_slot (worksheet, start_col);
-    char *end_label = get_time_slot (worksheet, end_col);
+    for (size_t i = 0; i < result->singles; i++)
+    {
+        result->single_range_count[i] = slot_ranges (result->single_list[i]->slots,
+                                                     result->single_ranges[i]);
+    }
+}
 
-    const char *start_time = start_label ? start_label : "";
-    const char *end_time = end_label ? end_label : "";
+/***************************  TOP LEVEL API (START)  ******************************/
 
-    /* Extract left of '~' from start_label and right of '~' from end_label */
-    char left[16] = {0};
-    char right[16] = {0};
+/* One evaluation of a priority function, possibly on a worker thread */
+struct heuristic_task
+{
+    relation_graph *graph;
+    member **members;
+    struct pairup_options *x;
+    pairup_internal algorithm;
+    int applied;                 // Index in `a[]` reported as the applied priority (-1: its own)
+    int index;                   // Position in the sweep
+    size_t upper_bound;          // No result can have more pairs than this
+    int *reached;                // Lowest position whose result hit the bound
+    bool pooled;                 // Submitted to the pool rather than run by the reduction
+    pairup_group group;          // Lets the reduction wait for this task alone
+    pair_result *result;
+};
 
-    if (start_time && *start_time)
-    {
-        const char *p = strchr (start_time, '~');
-        size_t n = (p ? (size_t)(p - start_time) : strlen(start_time));
-        if (n >= sizeof(left)) n = sizeof(left) - 1;
-        memcpy (left, start_time, n);
-        left[n] = '\0';
-    }
+/* The priorities with a search budget, worth a thread of their own */
+static bool
+is_budgeted_priority (pairup_internal algorithm)
+{
+    return algorithm == pairup_optimal_priority ||
+           algorithm == pairup_local_search_priority;
+}
 
-    if (end_time && *end_time)
-    {
-        const char *p = strchr (end_time, '~');
-        if (p && *(p+1))
-        {
-            strncpy (right, p + 1, sizeof(right) - 1);
-            right[sizeof(right) - 1] = '\0';
-        }
-        else
-        {
-            strncpy (right, end_time, sizeof(right) - 1);
-            right[sizeof(right) - 1] = '\0';
-        }
-    }
+/*
+ * A sweep that ends `gap` pairs below the bound gets this share of the
+ * default budgets: a small gap is usually closed, or proven closed, in a
+ * fraction of the time. Budgets the user set are kept as they are.
+ */
+#define FULL_BUDGET_GAP  4
+
+/* A share of `limit`, where zero (or less) still means no limit */
+static long
+scale_limit (long limit,
+             size_t gap)
+{
+    long scaled = limit * (long) gap / FULL_BUDGET_GAP;
+    return (limit > 0 && scaled < 1) ? 1 : scaled;
+}
 
-    if (left[0] && right[0])
+static void
+scale_budgets (struct pairup_options *scaled,
+               const struct pairup_options *x,
+               size_t gap)
+{
+    if (gap > FULL_BUDGET_GAP)
     {
-        snprintf (out, out_size, "%s~%s", left, right);
+        gap = FULL_BUDGET_GAP;
     }
-    else if (start_label && end_label)
+
+    *scaled = *x;
+    if (!x->exact_budget_given)
     {
-        /* Fallback: join full labels if parsing failed */
-        snprintf (out, out_size, "%s~%s", start_label, end_label);
+        scaled->exact_node_limit = (size_t) scale_limit ((long) x->exact_node_limit, gap);
+        scaled->exact_time_limit_ms = (int) scale_limit (x->exact_time_limit_ms, gap);
     }
-    else
+    if (!x->local_budget_given)
     {
-        *out = '\0';
+        scaled->local_iterations = (size_t) scale_limit ((long) x->local_iterations, gap);
+        scaled->local_time_limit_ms = (int) scale_limit (x->local_time_limit_ms, gap);
     }
 }
 
 static void
-collect_available_ranges (sheet_t *worksheet,
-                           int row,
-                           char ranges[][32],
-                           int *range_count)
+run_heuristic_task (void *arg)
 {
-    /* Scan availability columns and coalesce consecutive slots */
-    char cell[8];
-    int current_start = -1;
-    int last_col = -1;
-    int out_count = 0;
+    struct heuristic_task *task = (struct heuristic_task *) arg;
 
-    for (int j = FIELD_COL_START; j <= FIELD_COL_END; j++)
+    /* The reduction stops at an earlier result, or time is up: don't bother */
+    if (pairup_atomic_load (task->reached) < task->index ||
+        pairup_should_stop (&task->x->stop))
     {
-        get_cell (worksheet, row, j, cell, sizeof(cell));
-        int available = is_available (cell);
+        return;
+    }
 
-        if (available)
-        {
-            if (current_start == -1)
-            {
-                current_start = j;
-                last_col = j;
-            }
-            else if (j == last_col + 1)
-            {
-                last_col = j;
-            }
-            else
-            {
-                if (out_count < 64)
-                {
-                    append_range_string (worksheet, current_start, last_col, ranges[out_count], sizeof(ranges[out_count]));
-                    out_count++;
-                }
-                current_start = j;
-                last_col = j;
-            }
-        }
+    task->result = task->algorithm (task->graph, task->members, task->x);
+    if (task->applied >= 0)
+    {
+        task->result->algorithm_applied = (pairup_algorithm *) &a[task->applied];
     }
 
-    if (current_start != -1 && out_count < 64)
+    /* Re-pair around the singles the priority left behind */
+    if (task->x->augment)
     {
-        append_range_string (worksheet, current_start, last_col, ranges[out_count], sizeof(ranges[out_count]));
-        out_count++;
+        task->result = pairup_augment (task->graph, task->result, &task->x->stop);
     }
 
-    *range_count = out_count;
+    size_t bound = task->upper_bound;
+    if (task->result->upper_bound > 0 && task->result->upper_bound < bound)
+    {
+        bound = task->result->upper_bound;
+    }
+    if (task->result->pairs >= bound &&
+        task->index < pairup_atomic_load (task->reached))
+    {
+        pairup_atomic_store (task->reached, task->index);
+    }
 }
-/*
- * TODO: This will be merged into `pairup_bfs()` after making variable
- * `worksheet` globally accessible, since right now worksheet is passed
- * as a parameter everywhere and changing it will still need some effort
- * to check and make the code and API unstable as fuck. As a result, this
- * is a workaround for solving those function that needs `worksheet` but
- * actually we didn't provide.
- */
+
+/* The result outlives the graph, and its pairs and singles point to the members */
 static void
-pairup_bfs_EXT_time_suggestion (sheet *worksheet,
-                                pair_result *result)
+hand_over_members (relation_graph *graph,
+                   pair_result *result)
 {
-    if (result->singles != 0)
-    {
-
-        for (int i = 0; i < result->singles; i++)
-        {
-            member_t *member = result->single_list[i];
-            char ranges[64][32];
-            int n_ranges = 0;
-            collect_available_ranges(worksheet, member->id, ranges, &n_ranges);
-
-            char time_suggestion_str[256];
-            int offset = 0;
-
-            // Print ranges
-            for (int k = 0; k < n_ranges; k++)
-            {
-                offset += snprintf(time_suggestion_str + offset, sizeof(time_suggestion_str) - offset, "%s%s",
-                                   ranges[k], (k == n_ranges - 1) ? "" : ", ");
-            }
-            strcpy(result->single_suggestion_time[i], time_suggestion_str);
-        }
-    }
+    memcpy (result->members, graph->members, sizeof(result->members));
+    memset (graph->members, 0, sizeof(graph->members));
 }
 
-/***************************  TOP LEVEL API (START)  ******************************/
+static const struct pairup_algorithm sheet_order_algorithm = {
+    "SHEET_ORDER",                                // Relations as they were read, when time ran out.
+    NULL
+};
 
 /* The top-level pairup function */
 /* This function will iterate through all the priority functions */
@@ -344,24 +295,113 @@ __pairup__ (sheet *worksheet,
         struct pairup_options *x)
 {
     relation_graph *graph = new_relation_graph ();
-    member *member_list[MAX_MEMBERS_LEN] = { NULL };
+    member **member_list = graph->members;
+
+    /* The deadline counts from here */
+    pairup_stop_init (&x->stop, x);
 
     /* Generate relations using the existing member_list */
     /* This will take in the empty member_list and fill it with the available members */
     preprocess_fixed_memblist (worksheet, member_list, (void *)x->ensure_member_list);
     preprocess_relation_graph (worksheet, graph, member_list);
 
+    /* No ordering can beat this, so stop as soon as a result reaches it */
+    matching_view view;
+    matching_view_init (&view, graph);
+    size_t upper_bound = matching_upper_bound (&view);
+    int reached = MAX_MATCHES_LEN;
+
+    debug_printf (DEBUG_INFO, "[ INFO    ] At most %zu pairs are possible today.\n", upper_bound);
+
+    /* Plan the priorities to try, one task per evaluation */
+    struct heuristic_task tasks[sizeof(a) / sizeof(a[0])];
+    size_t n_tasks = 0;
+
+    int found = -1;
+    struct priority_expr expr;
+    if (x->ensure == false && x->priority == true)
+    {
+        found = get_algorithm_by_name (x->priority_func);
+        if (found < 0 && priority_compile (x->priority_func, &expr))
+        {
+            debug_printf (DEBUG_INFO,
+                          "[ INFO    ] Set the expression '%s' as the pairup priority.\n",
+                          x->priority_func);
+        }
+        else if (found < 0)
+        {
+            debug_printf (DEBUG_WARNING,
+                          "[ WARNING ] No pairup algorithm called '%s', fallback to default.\n",
+                          x->priority_func);
+            x->priority = false;
+        }
+        else
+        {
+            debug_printf (DEBUG_INFO,
+                          "[ INFO    ] Set '%s' as the pairup algorithm.\n",
+                          x->priority_func);
+        }
+    }
+
+    for (int i = 0; a[i].algorithm != NULL; i++)
+    {
+        struct heuristic_task *task = &tasks[n_tasks++];
+        task->graph = graph;
+        task->members = member_list;
+        task->x = x;
+        task->index = n_tasks - 1;
+        task->upper_bound = upper_bound;
+        task->reached = &reached;
+        task->pooled = false;
+        task->group.pending = 0;
+        task->result = NULL;
+
+        /* If --ensure={MEMBER} is used, then we do not care  */
+        /* about the pre-defined algorithm. Instead, a single */
+        /* maximum matching covers {MEMBER} whenever it can.  */
+        if (x->ensure == true)
+        {
+            task->algorithm = pairup_ensure_priority;
+            task->applied = -1;
+            break;
+        }
+        /* A specified priority gives the same result every time */
+        else if (x->priority == true && found < 0)
+        {
+            task->algorithm = pairup_expression_priority;
+            task->applied = -1;
+            break;
+        }
+        else if (x->priority == true)
+        {
+            task->algorithm = a[found].algorithm;
+            task->applied = found;
+            break;
+        }
+        else
+        {
+            task->algorithm = a[i].algorithm;
+            task->applied = i;
+        }
+    }
+
+    /* The budgeted priorities start once the greedy ones are reduced */
+    struct pairup_options *budgeted = NULL;  // Their own options in the default sweep
+    bool launched = false;
+    pairup_pool *pool = NULL;
+
     /* Initialize the best result and temporary result */
     result *best = NULL, *temp = NULL;
-    int id = -1;
+
+    /* Reduce in table order, exactly as if the priorities ran one by one */
+    pairup_random tie;
+    pairup_random_init (&tie, x->seed, PAIRUP_STREAM (PAIRUP_STREAM_TIE_BREAK, 0));
 
     int max_success_rate = 0;
     int current_success_rate = 0;
-    int current_total_requests = (temp && temp->total_requests > 0) ? temp->total_requests : 1;
-    for (int i = 0; a[i].algorithm != NULL; i++)
+    int current_total_requests = 1;
+    for (size_t i = 0; i < n_tasks; i++)
     {
-        pairup_internal algorithm;
-
         current_success_rate = (temp) ? (temp->pairs * 200 / current_total_requests) : current_success_rate;
         if (current_success_rate > max_success_rate)
             max_success_rate = current_success_rate;
@@ -370,41 +410,73 @@ __pairup__ (sheet *worksheet,
 [ INFO    ] Current successful request rate is at %d\%, trying next one ...\n",
 max_success_rate);
 
-        /* If --ensure={MEMBER} is used, then we do not care  */
-        /* about the pre-defined algorithm. Instead, we tried */ 
-        /* the `pairup_ensure_list_priority` several times to */
-        /* prioritize {MEMBER}.                               */
-        if (x->ensure == true)
-        {
-            algorithm = pairup_ensure_list_priority;
-        }
-        else if (x->priority == true)
+        /*
+         * The greedy priorities come first and stop at the bound, so the
+         * budgeted ones (OPTIMAL, LOCAL_SEARCH) only run on a gap, with a
+         * default budget for its size (none with -p). Every task
+         * sorts its own copy of the graph, so they can run side by side; a
+         * greedy pass costs less than handing it to a thread, and the sweep
+         * may itself run on a worker (a server or batch job).
+         */
+        if (!launched && is_budgeted_priority (tasks[i].algorithm))
         {
-            algorithm = get_algorithm_by_name (x->priority_func);
-            if (!algorithm)
+            launched = true;
+            /* Each one gives up once an earlier result is known to be final */
+            if (x->ensure == false && x->priority == false)
+            {
+                budgeted = (struct pairup_options *) malloc ((n_tasks - i) * sizeof(struct pairup_options));
+                for (size_t j = i; budgeted && j < n_tasks; j++)
+                {
+                    struct pairup_options *own = &budgeted[j - i];
+                    scale_budgets (own, x, upper_bound - (best ? best->pairs : 0));
+                    own->stop.reached = &reached;
+                    own->stop.index = tasks[j].index;
+                    tasks[j].x = own;
+                }
+            }
+
+            int jobs = (x->jobs > 0) ? x->jobs : pairup_pool_default_threads ();
+            if (jobs > (int) (n_tasks - i))
             {
-                debug_printf (DEBUG_WARNING,
-                              "[ WARNING ] No pairup algorithm called '%s', fallback to default.\n",
-                              x->priority_func);
-                x->priority = false;
+                jobs = n_tasks - i;
             }
-            else
+            if (jobs > 1 && !pairup_pool_in_worker ())
             {
-                debug_printf (DEBUG_INFO,
-                              "[ INFO    ] Set '%s' as the pairup algorithm.\n",
-                              x->priority_func);
+                pool = pairup_pool_new (jobs);
             }
+            for (size_t j = i; pool && j < n_tasks; j++)
+            {
+                tasks[j].pooled = pairup_pool_submit_group (pool, &tasks[j].group,
+                                                            run_heuristic_task, &tasks[j]);
+            }
+            if (pool)
+            {
+                debug_printf (DEBUG_INFO, "[ INFO    ] Evaluating %zu budgeted priorities on %d threads.\n",
+                              n_tasks - i, pairup_pool_threads (pool));
+            }
+        }
+
+        /* Get the pairing result of current algorithm */
+        if (tasks[i].pooled)
+        {
+            pairup_pool_wait_group (pool, &tasks[i].group);
         }
         else
         {
-            algorithm = a[i].algorithm;
+            run_heuristic_task (&tasks[i]);
+        }
+        temp = tasks[i].result;
+        tasks[i].result = NULL;
+        if (!temp)
+        {
+            continue;
         }
 
-        if (!algorithm) continue;
-
-        /* Get the pairing result of current algorithm */
-        temp = algorithm (graph, member_list);
-        temp->algorithm_applied = &a[i];
+        /* The exact search proves its own bound, which may be tighter */
+        if (temp->upper_bound > 0 && temp->upper_bound < upper_bound)
+        {
+            upper_bound = temp->upper_bound;
+        }
 
         debug_printf (DEBUG_INFO, "[ INFO    ] Applying the priority '%s' ...\n",
                       temp->algorithm_applied->name);
@@ -421,8 +493,7 @@ max_success_rate);
         }
         else if (temp->pairs == best->pairs)
         {
-            int rand = get_random_int ();
-            if (rand % 2 == 0)
+            if (pairup_random_below (&tie, 2) == 0)
             {
                 should_update_best = true;
             }
@@ -440,7 +511,6 @@ temp->algorithm_applied->name,
                 free_pair_result (best);
             }
             best = temp;
-            id = i;
         }
         else
         {
@@ -450,14 +520,61 @@ temp->algorithm_applied->name,
 (temp->pairs * 200 / current_total_requests));
 
             free_pair_result (temp);
+            temp = NULL;
         }
 
-        if (best->total_requests == (best->pairs << 1))
+        if (best->pairs >= upper_bound)
         {
             debug_printf (DEBUG_INFO, "[ INFO    ] Found the maximum matches, stop searching!\n");
             break;
         }
     }
+
+    /* Results computed ahead that the reduction did not look at */
+    if (pool)
+    {
+        pairup_pool_wait (pool);
+    }
+    for (size_t i = 0; i < n_tasks; i++)
+    {
+        free_pair_result (tasks[i].result);
+        if (tasks[i].x != x && pairup_atomic_load (&tasks[i].x->stop.stopped))
+        {
+            pairup_atomic_store (&x->stop.stopped, 1);
+        }
+    }
+    pairup_pool_free (pool);
+    free (budgeted);
+
+    /* Stopped before any priority ran: one pass in sheet order is still a result */
+    if (!best)
+    {
+        best = pairup_in_graph_order (graph, member_list);
+        best->algorithm_applied = (pairup_algorithm *) &sheet_order_algorithm;
+    }
+
+    /* Spend the remaining budget on random orders, which ignore the ensure list */
+    if (x->ensure == false && (x->seeds > 0 || x->time_budget_ms > 0))
+    {
+        best = pairup_multistart (graph, member_list, x, x->seed, upper_bound, best);
+    }
+
+    /*
+     * Below the bound, the budgeted priorities gave up on a budget: with more
+     * time (fewer jobs, an idle machine) they may have found more pairs.
+     */
+    if (launched && best->pairs < upper_bound)
+    {
+        best->unsettled = true;
+    }
+
+    if (pairup_atomic_load (&x->stop.stopped))
+    {
+        best->partial = true;
+        debug_printf (DEBUG_WARNING, "\
+[ WARNING ] Stopped early (deadline or cancellation), the result is the best found so far.\n");
+    }
+
     debug_printf (DEBUG_INFO, "[ INFO    ] No more method to try.\n");
     debug_printf (DEBUG_INFO, "[ INFO    ] Found best method: %s.\n", best->algorithm_applied->name);
 
@@ -465,56 +582,233 @@ temp->algorithm_applied->name,
     if (x->ensure == true || x->priority == true)
         debug_printf (DEBUG_SUMMARY, "[ SUMMARY ] Best Algorithm: None (Prioritized specific member(s))\n");
     else
-        debug_printf (DEBUG_SUMMARY, "[ SUMMARY ] Best Algorithm: %s\n", a[id].name);
+        debug_printf (DEBUG_SUMMARY, "[ SUMMARY ] Best Algorithm: %s\n", best->algorithm_applied->name);
+    debug_printf (DEBUG_SUMMARY, "[ SUMMARY ] Upper bound: %zu pairs (gap %zu)\n",
+                  upper_bound, (upper_bound > best->pairs) ? upper_bound - best->pairs : 0);
     debug_action (DEBUG_SUMMARY, (callback)display_summary, (void*)best);
     debug_printf (DEBUG_SUMMARY, "[ SUMMARY ] Relation Graph:\n");
     debug_action (DEBUG_SUMMARY, (callback)display_graph, (void*)graph);
 
+    hand_over_members (graph, best);
     free_relation_graph (graph);
 
-    // TODO: Make `worksheet` a global variable so that no garbage control flow like this will exist :(
-    pairup_bfs_EXT_time_suggestion(worksheet, best);
+    collect_single_ranges (best);
 
     return best;
 }
 
+/* The checks the command line leaves to its SIGSEGV handler */
+bool
+pairup_check_sheet (const sheet *worksheet,
+                    char *error,
+                    size_t error_size)
+{
+    if (!worksheet->data || worksheet->rows < FIELD_ROW_START + 1)
+    {
+        snprintf (error, error_size, "Invalid worksheet format");
+        return false;
+    }
+    if (worksheet->cols <= FIELD_COL_END)
+    {
+        snprintf (error, error_size, "Invalid worksheet format: %d columns, expected at least %d",
+                  worksheet->cols, FIELD_COL_END + 1);
+        return false;
+    }
+    if (worksheet->rows - 2 >= MAX_MEMBERS_LEN)
+    {
+        snprintf (error, error_size, "Invalid worksheet format: more than %d members",
+                  MAX_MEMBERS_LEN - 1);
+        return false;
+    }
+
+    return true;
+}
+
 graph *
 pairup_graph (sheet *worksheet)
 {
     relation_graph *graph = new_relation_graph ();
-    member *member_list[MAX_MEMBERS_LEN] = { NULL };
+    member **member_list = graph->members;
 
     /* Generate relations using the existing member_list */
     /* This will take in the empty member_list and fill it with the available members */
     preprocess_fixed_memblist (worksheet, member_list, NULL);
     preprocess_relation_graph (worksheet, graph, member_list);
 
-    pairup_internal algorithm = a[0].algorithm;
+    return graph;
+}
+
+size_t
+pairup_graph_edges (const relation_graph *graph,
+                    struct graph_edge **edges)
+{
+    size_t capacity = 0;
+    for (size_t i = 0; i < graph->count; i++)
+    {
+        capacity += graph->relations[i]->count - 1;
+    }
 
-    if (!algorithm) return NULL;
+    *edges = (struct graph_edge *) malloc ((capacity ? capacity : 1) * sizeof(struct graph_edge));
+    if (!*edges)
+    {
+        return 0;
+    }
 
-    /* Get the pairing result of current algorithm */
-    algorithm (graph, member_list);
+    /*
+     * A member is listed once per slot shared with a candidate, and both
+     * ends list each other: keep every pair once, at its first (earliest)
+     * slot. Bit `t` of `linked[s]` is set once the pair of rows `s` and `t`
+     * is kept.
+     */
+    uint64_t linked[MAX_MEMBERS_LEN] = { 0 };
+    size_t count = 0;
 
-    // printf("Best algorithm: %d\n", best_id);
-    return graph;
+    for (size_t i = 0; i < graph->count; i++)
+    {
+        relation *relation = graph->relations[i];
+        member *source = relation->candidates[0];
+
+        for (size_t j = 1; j < relation->count; j++)
+        {
+            member *target = relation->candidates[j];
+            uint64_t bit = (uint64_t) 1 << target->id;
+
+            if (linked[source->id] & bit)
+            {
+                continue;
+            }
+            linked[source->id] |= bit;
+            linked[target->id] |= (uint64_t) 1 << source->id;
+
+            (*edges)[count].a = source;
+            (*edges)[count].b = target;
+            (*edges)[count].time = relation->matched_slot[j];
+            count++;
+        }
+    }
+
+    return count;
 }
-/***************************  TOP LEVEL API (END)  ******************************/
 
-/* Generate a random integer, ensuring srand is initialized only once */
+static const struct pairup_algorithm repair_algorithm = {
+    "REPAIR",                                     // Previous result, repaired in place.
+    NULL
+};
+
+/* Vertex of the member called `name`, -1 if nobody is */
 static int
-get_random_int (void)
+repair_find_member (const matching_view *view,
+                    const char *name)
+{
+    for (size_t v = 0; v < view->count; v++)
+    {
+        if (strcmp (view->members[v]->name, name) == 0)
+        {
+            return v;
+        }
+    }
+
+    return -1;
+}
+
+/* Column of the slot labelled `label`, -1 if there is none */
+static slot
+repair_find_slot (sheet *worksheet,
+                  const char *label)
+{
+    for (int j = FIELD_COL_START; j <= FIELD_COL_END; j++)
+    {
+        char *current = get_time_slot (worksheet, j);
+        if (current && strcmp (current, label) == 0)
+        {
+            return j;
+        }
+    }
+
+    return -1;
+}
+
+pair_result_t *
+pairup_repair (sheet *worksheet,
+               const struct previous_pair previous[],
+               size_t count,
+               struct pairup_options *x)
 {
-    static int initialized = 0; // Static variable to track initialization
+    relation_graph *graph = new_relation_graph ();
+    member **member_list = graph->members;
+
+    pairup_stop_init (&x->stop, x);
+    preprocess_fixed_memblist (worksheet, member_list, NULL);
+    preprocess_relation_graph (worksheet, graph, member_list);
+
+    matching_view view;
+    matching_state state;
+    matching_view_init (&view, graph);
+    matching_state_init (&state, &view);
 
-    if (!initialized)
+    /* Keep every previous pair that the edited rows still allow */
+    struct matching_edge kept[MAX_MATCHES_LEN];
+    size_t n_kept = 0;
+    for (size_t i = 0; i < count; i++)
     {
-        srand ((unsigned int)time(NULL));
-        initialized = 1; // Mark as initialized
+        int u = repair_find_member (&view, previous[i].a);
+        int v = repair_find_member (&view, previous[i].b);
+        slot time = repair_find_slot (worksheet, previous[i].time);
+
+        if (u < 0 || v < 0 || time < 0 || matching_has_edge (&state, u, v) ||
+            !(matching_free_slots (&view, &state, u, v) & SLOT_BIT(time)))
+        {
+            debug_printf (DEBUG_INFO, "[ INFO    ] Dropping the previous pair %s & %s at %s.\n",
+                          previous[i].a, previous[i].b, previous[i].time);
+            continue;
+        }
+
+        matching_add (&state, u, v, time);
+        kept[n_kept].u = u;
+        kept[n_kept].v = v;
+        kept[n_kept].time = time;
+        n_kept++;
+    }
+
+    /* Pair up the freed requests, then trade a few kept pairs for more pairs */
+    matching_fill_greedy (&view, &state);
+    if (x->augment)
+    {
+        matching_augment (&view, &state, &x->stop);
+    }
+
+    size_t unchanged = 0;
+    for (size_t i = 0; i < n_kept; i++)
+    {
+        for (size_t j = 0; j < state.pairs; j++)
+        {
+            const struct matching_edge *e = &state.edges[j];
+            if (e->u == kept[i].u && e->v == kept[i].v && e->time == kept[i].time)
+            {
+                unchanged++;
+                break;
+            }
+        }
     }
 
-    return rand ();
+    debug_printf (DEBUG_SUMMARY, "\
+[ SUMMARY ] Repair: kept %zu of %zu previous pairs, %zu new pairs, %zu pairs in total (upper bound %zu)\n",
+unchanged, count, state.pairs - unchanged, state.pairs, matching_upper_bound (&view));
+
+    pair_result *result = matching_to_result (&view, &state);
+    result->algorithm_applied = (struct pairup_algorithm *) &repair_algorithm;
+    result->partial = pairup_atomic_load (&x->stop.stopped);
+
+    debug_action (DEBUG_SUMMARY, (callback)display_summary, (void*)result);
+
+    hand_over_members (graph, result);
+    free_relation_graph (graph);
+
+    collect_single_ranges (result);
+
+    return result;
 }
+/***************************  TOP LEVEL API (END)  ******************************/
 
 static int
 get_member_availability (sheet *worksheet,
@@ -554,6 +848,26 @@ get_member_earliest_slot (sheet *worksheet,
     return -1;
 }
 
+static slot_mask
+get_member_slots (sheet *worksheet,
+                  int id)
+{
+    int j;
+    char cell[8];
+    slot_mask slots = 0;
+
+    for (j = FIELD_COL_START; j <= FIELD_COL_END; j++)
+    {
+        get_cell (worksheet, id, j, cell, sizeof(cell));
+        if (is_available(cell))
+        {
+            slots |= SLOT_BIT(j);
+        }
+    }
+
+    return slots;
+}
+
 static int
 get_member_requests (sheet *worksheet,
                      int id)
@@ -605,45 +919,35 @@ get_row_id_by_name (sheet *worksheet,
     return -1;
 }
 
-/* Calculate the ensure score    */
-static int
-get_member_ensure_score (sheet *worksheet,
-                         void *elist,
-                         int row_id)
+/* Ensure score of every row: the member listed first gets the highest score */
+static void
+get_member_ensure_scores (sheet *worksheet,
+                          void *elist,
+                          int scores[])
 {
 /* Windows has unkown hang issue on calculating ensure score*/
 #if (defined(_WIN32) || defined(_WIN64))
-    return 0;
+    return;
 #endif
 
-    /* return the index in the ensure list and save to cache */
-    static bool initialized = false;
-    static int score_cache[MAX_MEMBERS_LEN];
-
-    if (initialized == false)
+    udel *ensure = (udel *)elist;
+    int highest = ensure->ensure_list_size + 1;
+    for (int i = 0; i < ensure->ensure_list_size; i++)
     {
-        udel *ensure = (udel *)elist;
-        size_t highest = ensure->ensure_list_size + 1;
-        for (int i = 0; i < ensure->ensure_list_size; i++)
-        {
-            debug_printf (DEBUG_INFO,
-                          "[ INFO    ] %s will be prioritized, with score = %d.\n",
-                          ensure->ensure_list_content[i],
-                          highest
-            );
-
-            int id = get_row_id_by_name (worksheet, ensure->ensure_list_content[i]);
-
-            if (id >= 0) {
-                score_cache[id] = highest--;
-            } else {
-                debug_printf(DEBUG_WARNING, "[ WARNING ] Warning: '%s' not found in worksheet\n", ensure->ensure_list_content[i]);
-            }
+        debug_printf (DEBUG_INFO,
+                      "[ INFO    ] %s will be prioritized, with score = %d.\n",
+                      ensure->ensure_list_content[i],
+                      highest
+        );
+
+        int id = get_row_id_by_name (worksheet, ensure->ensure_list_content[i]);
+
+        if (id >= 0 && id < MAX_MEMBERS_LEN) {
+            scores[id] = highest--;
+        } else {
+            debug_printf(DEBUG_WARNING, "[ WARNING ] Warning: '%s' not found in worksheet\n", ensure->ensure_list_content[i]);
         }
-        // Optional: Add a loop to fill priority "1" to the rest of the row id
-        initialized = true;
     }
-    return score_cache[row_id];
 }
 
 static int
@@ -652,9 +956,15 @@ preprocess_fixed_memblist (sheet *worksheet,
                            void *elist)
 {
     int i, count = 0;
+    int ensure_scores[MAX_MEMBERS_LEN] = { 0 };
 
     debug_printf(DEBUG_INFO, "[ INFO    ] Generating fixed member list ...\n");
 
+    if (elist)
+    {
+        get_member_ensure_scores (worksheet, elist, ensure_scores);
+    }
+
     for (i = FIELD_ROW_START; i < worksheet->rows - 1; i++)
     {
         member *member = new_member ();
@@ -670,9 +980,10 @@ preprocess_fixed_memblist (sheet *worksheet,
         member->requests = get_member_requests (worksheet, i);
         member->availability = get_member_availability (worksheet, i);
         member->earliest_slot = get_member_earliest_slot (worksheet, i);
+        member->slots = get_member_slots (worksheet, i);
 
         /* New */
-        member->ensure_score = (elist) ? get_member_ensure_score (worksheet, elist, i) : 0;
+        member->ensure_score = ensure_scores[i];
 
         mlist[i] = member;
         count++;
@@ -788,152 +1099,6 @@ member->ensure_score);
 //     return count;
 // }
 
-/********************  COMPARISON FUNCTIONS FOR QSORT (START)  ********************/
-
-/* Compare functions for qsort */
-static int
-compare_availability_asc (const void *a,
-                          const void *b)
-{
-    const relation *ra = *(const relation **)a;
-    const relation *rb = *(const relation **)b;
-
-    return (ra->candidates[0]->availability -
-            rb->candidates[0]->availability);  // Tie-breaking by priority
-}
-
-static int
-compare_availability_desc (const void *a,
-                           const void *b)
-{
-    const relation *ra = *(const relation **)a;
-    const relation *rb = *(const relation **)b;
-
-    return (rb->candidates[0]->availability -
-            ra->candidates[0]->availability);
-}
-
-static int
-compare_row_count_asc (const void *a,
-                       const void *b)
-{
-    const relation *ra = *(const relation **)a;
-    const relation *rb = *(const relation **)b;
-
-    return ra->count - rb->count;
-}
-
-static int
-compare_row_count_desc (const void *a,
-                        const void *b)
-{
-    const relation *ra = *(const relation **)a;
-    const relation *rb = *(const relation **)b;
-
-    return rb->count - ra->count;
-}
-
-static int
-compare_id_asc (const void *a,
-                const void *b)
-{
-    const relation *ra = *(const relation **)a;
-    const relation *rb = *(const relation **)b;
-
-    return (ra->candidates[0]->id - rb->candidates[0]->id);
-}
-
-static int
-compare_id_desc (const void *a,
-                 const void *b)
-{
-    const relation *ra = *(const relation **)a;
-    const relation *rb = *(const relation **)b;
-
-    return (rb->candidates[0]->id - ra->candidates[0]->id);
-}
-
-static int
-compare_requests_asc (const void *a,
-                      const void *b)
-{
-    const relation *ra = *(const relation **)a;
-    const relation *rb = *(const relation **)b;
-
-    return (ra->candidates[0]->requests - rb->candidates[0]->requests);
-}
-
-static int
-compare_requests_desc (const void *a,
-                       const void *b)
-{
-    const relation *ra = *(const relation **)a;
-    const relation *rb = *(const relation **)b;
-
-    return (rb->candidates[0]->requests - ra->candidates[0]->requests);
-}
-
-static int
-compare_earliest_slot_asc (const void *a,
-                           const void *b)
-{
-    const relation *ra = *(const relation **)a;
-    const relation *rb = *(const relation **)b;
-
-    return (ra->candidates[0]->earliest_slot -
-            rb->candidates[0]->earliest_slot);
-}
-
-static int
-compare_earliest_slot_desc (const void *a,
-                            const void *b)
-{
-    const relation *ra = *(const relation **)a;
-    const relation *rb = *(const relation **)b;
-
-    return (rb->candidates[0]->earliest_slot -
-            ra->candidates[0]->earliest_slot);
-}
-
-static int
-compare_ensure_list (const void *a,
-                     const void *b)
-{
-    const relation *ra = *(const relation **)a;
-    const relation *rb = *(const relation **)b;
-
-    /* Note that higher ensure score means higher priority, */
-    /* so we do a substraction in a reverse order.          */
-    int delta = rb->candidates[0]->ensure_score -
-                ra->candidates[0]->ensure_score;
-
-    if (delta == 0)
-    {
-        if (get_random_int () % 2 == 0)
-        {
-            return -1;
-        }
-        else
-        {
-            return 1;
-        }
-    }
-    else
-    {
-        return delta;
-    }
-}
-
-
-/* TODO: Record the modified time and implement this function */
-// static int
-// compare_first_modified_asc ()
-// {
-//     return 0;
-// }
-
-/*********************  COMPARISON FUNCTIONS FOR QSORT (END)  *********************/
-
 static int
 find_member_id (graph *today,
                 member *member)
@@ -1177,19 +1342,20 @@ pairup_bfs (graph *today,
 static pair_result *
 pairup_with_priority (graph *today,
                       member *members[],
-                      int (*compare_fn)(const void *, const void *))
+                      const struct priority_expr *expr)
 {
     /* Initialize the result */
     pair_result *result = new_pair_result (0, 0, 0);
 
-    /* Sort the members based on the provided comparison function */
-    qsort (today->relations, today->count, sizeof(relation *), compare_fn);
+    /* Sort a private copy, the shared graph stays untouched for other priorities */
+    relation_graph sorted = *today;
+    priority_sort (expr, &sorted);
 
     /*debug_printf (DEBUG_INFO, "[INFO   ] Sorted graph based on the priority.\n");*/
     /*debug_action (DEBUG_INFO, (callback)display_graph, (void*)today);*/
 
     /* Pair up the members */
-    pairup_bfs (today, members, result);
+    pairup_bfs (&sorted, members, result);
 
     /*debug_printf (DEBUG_INFO, "[SUMMARY] Pair result summary:\n");*/
     /*debug_action (DEBUG_INFO, (callback)display_summary, (void*)result);*/
@@ -1197,80 +1363,126 @@ pairup_with_priority (graph *today,
     return result;
 }
 
-/* Ensure List: ['Alice', 'Bob', 'Jackie'] */
+/* The built-in expressions always compile */
+static pair_result *
+pairup_with_expression (graph *today,
+                        member *members[],
+                        const char *expression)
+{
+    struct priority_expr expr;
+    priority_compile (expression, &expr);
+    return pairup_with_priority (today, members, &expr);
+}
+
+/* Keep whatever order `today->relations` is in */
+pair_result *
+pairup_in_graph_order (relation_graph *today,
+                       member *members[])
+{
+    pair_result *result = new_pair_result (0, 0, 0);
+
+    pairup_bfs (today, members, result);
+
+    return result;
+}
+
+static const struct pairup_algorithm expression_algorithm = {
+    "CUSTOM_PRIORITY",                            // Members ordered by `--priority` keys.
+    NULL
+};
+
 pair_result *
-pairup_ensure_list_priority (graph *graph,
-                             member *members[])
+pairup_expression_priority (graph *graph,
+                            member *members[],
+                            struct pairup_options *x)
 {
-    return pairup_with_priority (graph, members, compare_ensure_list);
+    struct priority_expr expr;
+    if (!x || !priority_compile (x->priority_func, &expr))
+    {
+        return NULL;
+    }
+
+    pair_result *result = pairup_with_priority (graph, members, &expr);
+    result->algorithm_applied = (struct pairup_algorithm *) &expression_algorithm;
+    return result;
 }
 
 pair_result *
 pairup_least_availability_priority (graph *graph,
-                                    member *members[])
+                                    member *members[],
+                                    struct pairup_options *x)
 {
-    return pairup_with_priority (graph, members, compare_availability_asc);
+    return pairup_with_expression (graph, members, "availability:asc");
 }
 
 pair_result *
 pairup_most_availability_priority (graph *graph,
-                                   member *members[])
+                                   member *members[],
+                                   struct pairup_options *x)
 {
-    return pairup_with_priority (graph, members, compare_availability_desc);
+    return pairup_with_expression (graph, members, "availability:desc");
 }
 
 pair_result *
 pairup_smallest_row_id_priority (graph *graph,
-                                 member *members[])
+                                 member *members[],
+                                 struct pairup_options *x)
 {
-    return pairup_with_priority (graph, members, compare_id_asc);
+    return pairup_with_expression (graph, members, "row:asc");
 }
 
 pair_result *
 pairup_largest_row_id_priority (graph *graph,
-                                member *members[])
+                                member *members[],
+                                struct pairup_options *x)
 {
-    return pairup_with_priority (graph, members, compare_id_desc);
+    return pairup_with_expression (graph, members, "row:desc");
 }
 
 pair_result *
 pairup_earliest_available_slot_priority (graph *graph,
-                                         member *members[])
+                                         member *members[],
+                                         struct pairup_options *x)
 {
-    return pairup_with_priority (graph, members, compare_earliest_slot_asc);
+    return pairup_with_expression (graph, members, "earliest:asc");
 }
 
 pair_result *
 pairup_latest_available_slot_priority (graph *graph,
-                                       member *members[])
+                                       member *members[],
+                                       struct pairup_options *x)
 {
-    return pairup_with_priority (graph, members, compare_earliest_slot_desc);
+    return pairup_with_expression (graph, members, "earliest:desc");
 }
 
 pair_result *
 pairup_least_partner_priority (graph *graph,
-                               member *members[])
+                               member *members[],
+                               struct pairup_options *x)
 {
-    return pairup_with_priority (graph, members, compare_row_count_asc);
+    return pairup_with_expression (graph, members, "partners:asc");
 }
 
 pair_result *
 pairup_most_partner_priority (graph *graph,
-                              member *members[])
+                              member *members[],
+                              struct pairup_options *x)
 {
-    return pairup_with_priority (graph, members, compare_row_count_desc);
+    return pairup_with_expression (graph, members, "partners:desc");
 }
 
 pair_result *
 pairup_least_request_priority (graph *graph,
-                               member *members[])
+                               member *members[],
+                               struct pairup_options *x)
 {
-    return pairup_with_priority (graph, members, compare_requests_asc);
+    return pairup_with_expression (graph, members, "requests:asc");
 }
 
 pair_result *
 pairup_most_request_priority (graph *graph,
-                              member *members[])
+                              member *members[],
+                              struct pairup_options *x)
 {
-    return pairup_with_priority (graph, members, compare_requests_desc);
+    return pairup_with_expression (graph, members, "requests:desc");
 }
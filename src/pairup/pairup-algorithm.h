@@ -10,54 +10,124 @@ pair_result_t *
 __pairup__ (sheet *sheet,
         struct pairup_options *x);
 
+/* Who can meet whom on `worksheet`, in row order, without pairing anyone up */
 relation_graph *
 pairup_graph (sheet *worksheet);
 
+/* Two members who can meet, and the earliest slot they share */
+struct graph_edge
+{
+    member *a;
+    member *b;
+    slot time;
+};
+
+/* Every pair of `graph` once, in row order; free `*edges` with `free` */
+size_t
+pairup_graph_edges (const relation_graph *graph,
+                    struct graph_edge **edges);
+
+/* Whether `worksheet` can be paired up at all (the checks the command line */
+/* leaves to its SIGSEGV handler); `error` tells why not                     */
+bool
+pairup_check_sheet (const sheet *worksheet,
+                    char *error,
+                    size_t error_size);
+
+/* Repair `previous` after some members edited their rows on `worksheet`: */
+/* pairs that still fit are kept, and only the freed requests are paired */
+/* up again. Note that the result should be freed by the caller */
+pair_result_t *
+pairup_repair (sheet *worksheet,
+               const struct previous_pair previous[],
+               size_t count,
+               struct pairup_options *x);
+
 /* Member-availability-based algorithms for probing optimized results */
 /* The member filled with the least/most time slots will be paired up first */
 pair_result_t *
 pairup_least_availability_priority (relation_graph *today,
-                                    member *mlist[]);
+                                    member *mlist[],
+                                    struct pairup_options *x);
 
 pair_result_t *
 pairup_most_availability_priority (relation_graph *today,
-                                    member *mlist[]);
+                                    member *mlist[],
+                                    struct pairup_options *x);
 
 /* Sheet read-order-based algorithms for probing optimized results */
 /* The member on the top/bottom of the sheet will be paired up first */
 pair_result_t *
 pairup_smallest_row_id_priority (relation_graph *today,
-                                 member *mlist[]);
+                                 member *mlist[],
+                                 struct pairup_options *x);
 
 pair_result_t *
 pairup_largest_row_id_priority (relation_graph *today,
-                                member *mlist[]);
+                                member *mlist[],
+                                struct pairup_options *x);
 
 /* Time-order-based algorithms for probing optimized results */
 /* The member who has the earliest/latest time slot will be paired up first */
 pair_result_t *
 pairup_earliest_available_slot_priority (relation_graph *today,
-                                         member *mlist[]);
+                                         member *mlist[],
+                                         struct pairup_options *x);
 
 pair_result_t *
 pairup_latest_available_slot_priority (relation_graph *today,
-                                       member *mlist[]);
+                                       member *mlist[],
+                                       struct pairup_options *x);
 
 /* Potential-partner-based algorithms for probing optimized results */
 pair_result_t *
 pairup_least_partner_priority (relation_graph *today,
-                               member *members[]);
+                               member *members[],
+                               struct pairup_options *x);
 
 pair_result_t *
 pairup_most_partner_priority (relation_graph *today,
-                              member *members[]);
+                              member *members[],
+                              struct pairup_options *x);
 
 pair_result_t *
 pairup_least_request_priority (relation_graph *today,
-                               member *members[]);
+                               member *members[],
+                               struct pairup_options *x);
 
 pair_result_t *
 pairup_most_request_priority (relation_graph *today,
-                              member *members[]);
+                              member *members[],
+                              struct pairup_options *x);
+
+/* Members ordered by the keys of the `x->priority_func` expression, */
+/* e.g. "availability:asc,requests:desc" (see pairup-priority.h)      */
+pair_result_t *
+pairup_expression_priority (relation_graph *today,
+                            member *members[],
+                            struct pairup_options *x);
+
+/* Exact maximum matching: Edmonds' blossom, or branch-and-bound for 'twice' members */
+pair_result_t *
+pairup_optimal_priority (relation_graph *today,
+                         member *members[],
+                         struct pairup_options *x);
+
+/* Maximum matching that gives every ensured member a partner whenever possible */
+pair_result_t *
+pairup_ensure_priority (relation_graph *today,
+                        member *members[],
+                        struct pairup_options *x);
+
+/* Simulated annealing over pair, slot and partner moves, for sheets too big to solve exactly */
+pair_result_t *
+pairup_local_search_priority (relation_graph *today,
+                              member *members[],
+                              struct pairup_options *x);
+
+/* Pair up in the current order of the relations (used by randomized search) */
+pair_result_t *
+pairup_in_graph_order (relation_graph *today,
+                       member *members[]);
 
 #endif  // PAIRUP_ALGORITHM_H
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pairup-batch.h"
+#include "pairup-algorithm.h"
+#include "pairup-cache.h"
+#include "pairup-formatter.h"
+#include "pairup-pool.h"
+#include "pairup-types.h"
+#include "rw-csv.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <pthread.h>
+#define batch_lock(b)    pthread_mutex_lock (&(b)->lock)
+#define batch_unlock(b)  pthread_mutex_unlock (&(b)->lock)
+#else
+#define batch_lock(b)    ((void) 0)
+#define batch_unlock(b)  ((void) 0)
+#endif
+
+struct batch
+{
+#if !defined(_WIN32) && !defined(_WIN64)
+    pthread_mutex_t lock;        // Guards `out` and `failed`
+#endif
+    FILE *out;
+    struct pairup_options defaults;
+    const char *salt;
+    size_t failed;               // Runs answered with an error line
+};
+
+/* One run of one sheet */
+struct batch_task
+{
+    struct batch *batch;
+    const char *path;
+    size_t run;
+};
+
+static void
+batch_log_to_stderr (void *user,
+                     int level,
+                     const char *message)
+{
+    fputs (message, stderr);
+}
+
+/* Write one line and flush it, so a reader sees every run as it finishes */
+static void
+batch_emit (struct batch *b,
+            const struct result_json_run *run,
+            sheet *worksheet,
+            pair_result *result,
+            const char *message)
+{
+    batch_lock (b);
+    fprint_result_ndjson (b->out, run, worksheet, result, message);
+    fflush (b->out);
+    if (!result)
+    {
+        b->failed++;
+    }
+    batch_unlock (b);
+}
+
+static void
+batch_run (void *arg)
+{
+    struct batch_task *task = (struct batch_task *) arg;
+    struct batch *b = task->batch;
+    struct pairup_options x = b->defaults;
+    struct result_json_run run = { task->path, task->run, 0, 0.0, 0.0 };
+    char error[256];
+
+    double start = pairup_clock_ms ();
+    sheet *worksheet = (sheet *) calloc (1, sizeof(sheet));
+    if (!worksheet)
+    {
+        batch_emit (b, &run, NULL, NULL, "Out of memory");
+        return;
+    }
+    *worksheet = try_read_csv (task->path);
+    run.read_ms = pairup_clock_ms () - start;
+
+    if (!worksheet->path)
+    {
+        snprintf (error, sizeof(error), "Cannot open the sheet");
+    }
+    if (!worksheet->path || !pairup_check_sheet (worksheet, error, sizeof(error)))
+    {
+        batch_emit (b, &run, NULL, NULL, error);
+        if (worksheet->data)
+        {
+            free_sheet (&worksheet);
+        }
+        else
+        {
+            free (worksheet->path);
+            free (worksheet);
+        }
+        return;
+    }
+
+    /* The key is taken before shuffling, like the cached command line does */
+    uint64_t base = x.seeded ? x.seed : pairup_cache_key (worksheet, &x, b->salt);
+    x.seed = base + task->run;
+    run.seed = x.seed;
+
+    start = pairup_clock_ms ();
+    shuffle_worksheet (worksheet, x.seed);
+    pair_result *result = __pairup__ (worksheet, &x);
+    run.solve_ms = pairup_clock_ms () - start;
+
+    batch_emit (b, &run, worksheet, result, NULL);
+
+    free_pair_result (result);
+    free_sheet (&worksheet);
+}
+
+int
+pairup_run_ndjson (char *const paths[],
+                   size_t n,
+                   size_t runs,
+                   const struct pairup_options *x,
+                   const char *salt,
+                   FILE *out)
+{
+    struct batch b;
+    size_t n_tasks = n * runs;
+
+    memset (&b, 0, sizeof(b));
+    b.out = out;
+    b.defaults = *x;
+    b.defaults.json_output = true;  // Keyed like `pairup -j`
+    b.salt = salt;
+
+    struct batch_task *tasks = (struct batch_task *) calloc (n_tasks ? n_tasks : 1, sizeof(struct batch_task));
+    if (!tasks)
+    {
+        fprintf (stderr, "Memory allocation failed for the batch\n");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < n_tasks; i++)
+    {
+        tasks[i].batch = &b;
+        tasks[i].path = paths[i / runs];
+        tasks[i].run = i % runs;
+    }
+
+    /* Keep stdout for results only */
+    struct pairup_log log = { x->debug_level, batch_log_to_stderr, NULL };
+    const struct pairup_log *saved = pairup_log_swap (&log);
+
+#if !defined(_WIN32) && !defined(_WIN64)
+    pthread_mutex_init (&b.lock, NULL);
+#endif
+
+    /* Runs side by side, each one solved on its own thread */
+    pairup_pool *pool = NULL;
+    int jobs = (x->jobs > 0) ? x->jobs : pairup_pool_default_threads ();
+    if (jobs > 1 && n_tasks > 1)
+    {
+        pool = pairup_pool_new (jobs);
+        b.defaults.jobs = 1;
+    }
+
+    double start = pairup_clock_ms ();
+    for (size_t i = 0; i < n_tasks; i++)
+    {
+        if (!pool || !pairup_pool_submit (pool, batch_run, &tasks[i]))
+        {
+            batch_run (&tasks[i]);
+        }
+    }
+    if (pool)
+    {
+        pairup_pool_wait (pool);
+        pairup_pool_free (pool);
+    }
+
+    debug_printf (DEBUG_SUMMARY, "\
+[ SUMMARY ] NDJSON: %zu runs of %zu sheets in %.1f ms, %zu failed.\n",
+n_tasks, n, pairup_clock_ms () - start, b.failed);
+
+#if !defined(_WIN32) && !defined(_WIN64)
+    pthread_mutex_destroy (&b.lock);
+#endif
+
+    pairup_log_swap (saved);
+    free (tasks);
+
+    return (b.failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
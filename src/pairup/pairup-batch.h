@@ -0,0 +1,30 @@
+#ifndef PAIRUP_BATCH_H
+#define PAIRUP_BATCH_H
+
+#include <stdio.h>
+
+#include "pairup-types.h"
+
+/*
+ * Pair up every sheet in `paths` `runs` times and write one line of NDJSON
+ * per run to `out` as soon as it finishes, so a consumer can stream results
+ * while later runs are still being solved. Lines come in completion order;
+ * "sheet" and "run" say which one each line belongs to.
+ *
+ * Run `i` of a sheet is seeded with `x->seed + i`, or without --seed with
+ * the sheet's cache key plus `i`, so run 0 pairs like `pairup -j` does. A
+ * sheet that cannot be read gives an error line for each of its runs.
+ *
+ * Runs are spread over `x->jobs` threads, and log messages go to stderr so
+ * that `out` holds nothing but results. `salt` (the program version) is
+ * mixed into every key. Returns the process exit status.
+ */
+int
+pairup_run_ndjson (char *const paths[],
+                   size_t n,
+                   size_t runs,
+                   const struct pairup_options *x,
+                   const char *salt,
+                   FILE *out);
+
+#endif  // PAIRUP_BATCH_H
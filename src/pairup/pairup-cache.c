@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <direct.h>
+#include <process.h>
+#define cache_mkdir(path)  _mkdir (path)
+#define cache_getpid()     _getpid ()
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#define cache_mkdir(path)  mkdir (path, 0755)
+#define cache_getpid()     getpid ()
+#endif
+
+#include "pairup-cache.h"
+#include "pairup-formatter.h"
+#include "pairup-types.h"
+
+#define FNV_OFFSET  0xCBF29CE484222325ULL
+#define FNV_PRIME   0x100000001B3ULL
+
+static uint64_t
+fnv_bytes (uint64_t h,
+           const void *data,
+           size_t size)
+{
+    const unsigned char *p = (const unsigned char *) data;
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+/* Strings are hashed with their terminator, so "ab","c" differs from "a","bc" */
+static uint64_t
+fnv_string (uint64_t h,
+            const char *s)
+{
+    return fnv_bytes (h, s ? s : "", s ? strlen (s) + 1 : 1);
+}
+
+static uint64_t
+fnv_u64 (uint64_t h,
+         uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        h = fnv_bytes (h, &(unsigned char) { (unsigned char) (v >> (8 * i)) }, 1);
+    }
+    return h;
+}
+
+static const char *
+sheet_cell (sheet *worksheet,
+            int row,
+            int col)
+{
+    return (col < worksheet->cols) ? worksheet->data[row][col] : NULL;
+}
+
+uint64_t
+pairup_cache_key (sheet *worksheet,
+                  const struct pairup_options *x,
+                  const char *salt)
+{
+    uint64_t h = fnv_string (FNV_OFFSET, salt);
+
+    for (int j = FIELD_COL_START; j <= FIELD_COL_END; j++)
+    {
+        h = fnv_string (h, sheet_cell (worksheet, 0, j));
+    }
+
+    /* Only what the solver sees: the sign of each cell, not how it is written */
+    for (int i = FIELD_ROW_START; i < worksheet->rows - 1; i++)
+    {
+        h = fnv_string (h, sheet_cell (worksheet, i, FIELD_COL_NAME));
+        for (int j = FIELD_COL_START; j <= FIELD_COL_END; j++)
+        {
+            const char *cell = sheet_cell (worksheet, i, j);
+            unsigned char sign = !cell ? 0 : is_twice (cell) ? 2 : is_once (cell) ? 1 : 0;
+            h = fnv_bytes (h, &sign, 1);
+        }
+    }
+
+    h = fnv_u64 (h, x->json_output);
+    h = fnv_u64 (h, x->priority);
+    h = fnv_string (h, x->priority ? x->priority_func : NULL);
+    h = fnv_u64 (h, x->ensure);
+    if (x->ensure && x->ensure_member_list)
+    {
+        for (size_t i = 0; i < x->ensure_member_list->ensure_list_size; i++)
+        {
+            h = fnv_string (h, x->ensure_member_list->ensure_list_content[i]);
+        }
+    }
+    h = fnv_u64 (h, x->exact_node_limit);
+    h = fnv_u64 (h, x->exact_time_limit_ms);
+    h = fnv_u64 (h, x->exact_budget_given);
+    h = fnv_u64 (h, x->local_iterations);
+    h = fnv_u64 (h, x->local_time_limit_ms);
+    h = fnv_u64 (h, x->local_budget_given);
+    h = fnv_u64 (h, x->augment);
+    h = fnv_u64 (h, x->seeds);
+    h = fnv_u64 (h, x->seeded);  // --seed=0 is not the seed taken from the key
+    h = fnv_u64 (h, x->seed);
+
+    return h;
+}
+
+/* mkdir -p, for the few levels a cache directory may be missing */
+static bool
+cache_make_dirs (char *path)
+{
+    for (char *p = path + 1; *p; p++)
+    {
+        if (*p == '/')
+        {
+            *p = '\0';
+            if (cache_mkdir (path) != 0 && errno != EEXIST)
+            {
+                *p = '/';
+                return false;
+            }
+            *p = '/';
+        }
+    }
+
+    return cache_mkdir (path) == 0 || errno == EEXIST;
+}
+
+bool
+pairup_cache_dir (const char *override,
+                  char *out,
+                  size_t out_size)
+{
+    const char *xdg = getenv ("XDG_CACHE_HOME");
+    const char *home = getenv ("HOME");
+    int n;
+
+    if (override && *override)
+    {
+        n = snprintf (out, out_size, "%s", override);
+    }
+    else if (xdg && *xdg)
+    {
+        n = snprintf (out, out_size, "%s/pairup", xdg);
+    }
+    else if (home && *home)
+    {
+        n = snprintf (out, out_size, "%s/.cache/pairup", home);
+    }
+    else
+    {
+        return false;
+    }
+
+    if (n <= 0 || (size_t) n >= out_size)
+    {
+        return false;
+    }
+
+    if (!cache_make_dirs (out))
+    {
+        debug_printf (DEBUG_WARNING, "[ WARNING ] Cannot create the cache directory '%s'.\n", out);
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+cache_path (const char *dir,
+            uint64_t key,
+            const char *ext,
+            char *out,
+            size_t out_size)
+{
+    int n = snprintf (out, out_size, "%s/%016llx.%s", dir, (unsigned long long) key, ext);
+    return n > 0 && (size_t) n < out_size;
+}
+
+FILE *
+pairup_cache_open (const char *dir,
+                   uint64_t key,
+                   const char *ext)
+{
+    char path[2048];
+    if (!cache_path (dir, key, ext, path, sizeof(path)))
+    {
+        return NULL;
+    }
+
+    return fopen (path, "rb");
+}
+
+FILE *
+pairup_cache_create (const char *dir,
+                     uint64_t key,
+                     const char *ext,
+                     char *tmp_path,
+                     size_t tmp_size)
+{
+    int n = snprintf (tmp_path, tmp_size, "%s/%016llx.%s.%d.tmp",
+                      dir, (unsigned long long) key, ext, (int) cache_getpid ());
+    if (n <= 0 || (size_t) n >= tmp_size)
+    {
+        return NULL;
+    }
+
+    return fopen (tmp_path, "wb");
+}
+
+bool
+pairup_cache_commit (FILE *file,
+                     const char *dir,
+                     uint64_t key,
+                     const char *ext,
+                     const char *tmp_path)
+{
+    char path[2048];
+    bool ok = !ferror (file);
+
+    ok = (fclose (file) == 0) && ok;
+    ok = ok && cache_path (dir, key, ext, path, sizeof(path));
+#if defined(_WIN32) || defined(_WIN64)
+    if (ok)
+    {
+        remove (path);
+    }
+#endif
+    ok = ok && rename (tmp_path, path) == 0;
+
+    if (!ok)
+    {
+        remove (tmp_path);
+    }
+    return ok;
+}
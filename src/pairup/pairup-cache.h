@@ -0,0 +1,52 @@
+#ifndef PAIRUP_CACHE_H
+#define PAIRUP_CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pairup-types.h"
+#include "rw-csv.h"
+
+/*
+ * On-disk result cache.
+ *
+ * The key is a 64-bit FNV-1a hash of the classified sheet (names, requests
+ * and availability of every row, plus the slot labels), every option that
+ * changes the result, and `salt` (the program version), so a rebuilt binary
+ * never serves results of an older one. Entries are plain files named after
+ * the key, written to a temporary file first and renamed into place.
+ */
+uint64_t
+pairup_cache_key (sheet *worksheet,
+                  const struct pairup_options *x,
+                  const char *salt);
+
+/* `override`, $XDG_CACHE_HOME/pairup or ~/.cache/pairup (created if needed) */
+bool
+pairup_cache_dir (const char *override,
+                  char *out,
+                  size_t out_size);
+
+/* Open the entry `key` for reading, NULL on a miss */
+FILE *
+pairup_cache_open (const char *dir,
+                   uint64_t key,
+                   const char *ext);
+
+/* Start writing the entry `key`, `tmp_path` receives the temporary file name */
+FILE *
+pairup_cache_create (const char *dir,
+                     uint64_t key,
+                     const char *ext,
+                     char *tmp_path,
+                     size_t tmp_size);
+
+/* Close `file` and move it into place, false (and nothing stored) on failure */
+bool
+pairup_cache_commit (FILE *file,
+                     const char *dir,
+                     uint64_t key,
+                     const char *ext,
+                     const char *tmp_path);
+
+#endif  // PAIRUP_CACHE_H
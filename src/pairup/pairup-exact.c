@@ -0,0 +1,626 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pairup-exact.h"
+#include "pairup-algorithm.h"
+#include "pairup-formatter.h"
+#include "pairup-matching.h"
+#include "pairup-pool.h"
+#include "pairup-types.h"
+
+/* Check the clock once every this many search nodes */
+#define EXACT_CLOCK_INTERVAL 256
+
+struct exact_search
+{
+    const matching_view *view;
+    matching_state state;                // Matching on the current branch
+    matching_state *best;                // Incumbent
+    uint64_t partners[MAX_MATCHES_LEN];  // Vertices already paired with `v`
+    uint64_t banned[MAX_MATCHES_LEN];    // Partners excluded on this branch
+    uint64_t required;                   // Vertices every matching must cover
+    size_t nodes;
+    size_t node_limit;
+    double deadline;
+    struct pairup_stop *stop;    // Deadline and cancellation of the whole solve
+    bool stopped;
+};
+
+/* Partners `v` may still take on this branch, `reach` gets the usable slots */
+static uint64_t
+exact_options (const struct exact_search *s,
+               int v,
+               slot_mask *reach)
+{
+    const matching_view *view = s->view;
+    uint64_t options = 0;
+
+    *reach = 0;
+    if (s->state.remain[v] <= 0)
+    {
+        return 0;
+    }
+
+    uint64_t candidates = view->adjacent[v] & ~s->partners[v] & ~s->banned[v];
+    slot_mask free_v = view->slots[v] & ~s->state.used[v];
+
+    for (size_t w = 0; w < view->count; w++)
+    {
+        if (!(candidates & ((uint64_t) 1 << w)) || s->state.remain[w] <= 0)
+        {
+            continue;
+        }
+
+        slot_mask common = free_v & view->slots[w] & ~s->state.used[w];
+        if (common)
+        {
+            options |= (uint64_t) 1 << w;
+            *reach |= common;
+        }
+    }
+
+    return options;
+}
+
+/*
+ * Every vertex can take at most min(remaining requests, partners left,
+ * slots left) more pairs, and each pair consumes two of those. `pick` gets
+ * the open vertex with the fewest options, which is the one to branch on.
+ */
+static size_t
+exact_bound (const struct exact_search *s,
+             int *pick)
+{
+    size_t total = 0;
+    int fewest = MAX_MATCHES_LEN + 1;
+
+    *pick = -1;
+    for (size_t v = 0; v < s->view->count; v++)
+    {
+        slot_mask reach;
+        uint64_t options = exact_options (s, v, &reach);
+        if (!options)
+        {
+            continue;
+        }
+
+        int degree = matching_popcount (options);
+        int cap = s->state.remain[v];
+        if (degree < cap) cap = degree;
+        if (matching_popcount (reach) < cap) cap = matching_popcount (reach);
+        total += cap;
+
+        if (degree < fewest)
+        {
+            fewest = degree;
+            *pick = v;
+        }
+    }
+
+    return s->state.pairs + total / 2;
+}
+
+/* Whether a required vertex is uncovered, and `final` says nobody is left to cover it */
+static bool
+exact_uncovered (const struct exact_search *s,
+                 bool final)
+{
+    for (size_t v = 0; v < s->view->count; v++)
+    {
+        if (!(s->required & ((uint64_t) 1 << v)) || s->state.remain[v] < s->view->capacity[v])
+        {
+            continue;
+        }
+
+        slot_mask reach;
+        if (!final || !exact_options (s, v, &reach))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool
+exact_out_of_budget (struct exact_search *s)
+{
+    if (s->node_limit && s->nodes >= s->node_limit)
+    {
+        s->stopped = true;
+    }
+    else if (s->deadline > 0 &&
+             s->nodes % EXACT_CLOCK_INTERVAL == 0 &&
+             pairup_clock_ms () >= s->deadline)
+    {
+        s->stopped = true;
+    }
+    else if (s->stop && s->nodes % EXACT_CLOCK_INTERVAL == 0 &&
+             pairup_should_stop (s->stop))
+    {
+        s->stopped = true;
+    }
+
+    return s->stopped;
+}
+
+static void
+exact_branch (struct exact_search *s)
+{
+    s->nodes++;
+    if (exact_out_of_budget (s))
+    {
+        return;
+    }
+
+    /* No way left to cover a required vertex on this branch */
+    if (s->required && exact_uncovered (s, true))
+    {
+        return;
+    }
+
+    if (s->state.pairs > s->best->pairs && !(s->required && exact_uncovered (s, false)))
+    {
+        *s->best = s->state;
+    }
+
+    int u;
+    size_t bound = exact_bound (s, &u);
+    if (u < 0 || bound <= s->best->pairs)
+    {
+        return;
+    }
+
+    slot_mask reach;
+    uint64_t options = exact_options (s, u, &reach);
+    uint64_t banned_u = s->banned[u];
+    uint64_t banned_back = 0;
+
+    /* Branch i: `u` meets its i-th option, and none of the earlier ones */
+    for (size_t v = 0; v < s->view->count && !s->stopped; v++)
+    {
+        uint64_t bit_v = (uint64_t) 1 << v;
+        if (!(options & bit_v))
+        {
+            continue;
+        }
+
+        slot_mask common = matching_free_slots (s->view, &s->state, u, v);
+        for (int k = 0; k < MAX_SLOTS_LEN && !s->stopped; k++)
+        {
+            if (!(common & ((slot_mask) 1 << k)))
+            {
+                continue;
+            }
+
+            matching_add (&s->state, u, v, FIELD_COL_START + k);
+            s->partners[u] |= bit_v;
+            s->partners[v] |= (uint64_t) 1 << u;
+
+            exact_branch (s);
+
+            matching_remove (&s->state, s->state.pairs - 1);
+            s->partners[u] &= ~bit_v;
+            s->partners[v] &= ~((uint64_t) 1 << u);
+        }
+
+        s->banned[u] |= bit_v;
+        if (!(s->banned[v] & ((uint64_t) 1 << u)))
+        {
+            s->banned[v] |= (uint64_t) 1 << u;
+            banned_back |= bit_v;
+        }
+    }
+
+    /* Last branch: `u` takes none of its options */
+    if (!s->stopped)
+    {
+        exact_branch (s);
+    }
+
+    s->banned[u] = banned_u;
+    for (size_t v = 0; v < s->view->count; v++)
+    {
+        if (banned_back & ((uint64_t) 1 << v))
+        {
+            s->banned[v] &= ~((uint64_t) 1 << u);
+        }
+    }
+}
+
+void
+exact_search (const matching_view *view,
+              matching_state *best,
+              uint64_t required,
+              const struct exact_budget *budget,
+              struct exact_stats *stats)
+{
+    struct exact_search s;
+    double start = pairup_clock_ms ();
+
+    s.view = view;
+    s.best = best;
+    s.nodes = 0;
+    s.node_limit = budget ? budget->node_limit : 0;
+    s.deadline = (budget && budget->time_limit_ms > 0) ? start + budget->time_limit_ms : 0;
+    s.stop = budget ? budget->stop : NULL;
+    s.stopped = false;
+    s.required = required;
+
+    matching_state_init (&s.state, view);
+    for (size_t v = 0; v < view->count; v++)
+    {
+        s.partners[v] = 0;
+        s.banned[v] = 0;
+    }
+
+    int root_pick;
+    size_t root_bound = exact_bound (&s, &root_pick);
+    if (matching_upper_bound (view) < root_bound)
+    {
+        root_bound = matching_upper_bound (view);
+    }
+
+    exact_branch (&s);
+
+    stats->nodes = s.nodes;
+    stats->optimal = !s.stopped || best->pairs >= root_bound;
+    stats->upper_bound = stats->optimal ? best->pairs : root_bound;
+    stats->elapsed_ms = pairup_clock_ms () - start;
+}
+
+/* One connected component, solved on its own */
+struct component_task
+{
+    matching_view view;
+    int vertex[MAX_MATCHES_LEN];         // Component vertex -> graph vertex
+    matching_state state;                // Incumbent when `required` is set
+    uint64_t required;                   // Component vertices to keep covered
+    struct exact_budget budget;
+    struct exact_stats stats;
+    bool searched;                       // Whether branch-and-bound ran
+};
+
+/* Blossom when everybody requests once, branch-and-bound otherwise */
+static void
+component_solve (void *arg)
+{
+    struct component_task *task = (struct component_task *) arg;
+    matching_view *view = &task->view;
+
+    /* A required cover comes with a matching that satisfies it */
+    if (!task->required)
+    {
+        matching_from_maximum (view, &task->state);
+    }
+
+    task->searched = false;
+    for (size_t v = 0; v < view->count; v++)
+    {
+        if (view->capacity[v] > 1)
+        {
+            task->searched = true;
+        }
+    }
+
+    if (task->searched)
+    {
+        exact_search (view, &task->state, task->required, &task->budget, &task->stats);
+    }
+    else
+    {
+        task->stats.nodes = 0;
+        task->stats.optimal = true;
+        task->stats.upper_bound = task->state.pairs;
+        task->stats.elapsed_ms = 0;
+    }
+}
+
+/*
+ * Pairs never cross the connected components of the shared-slot graph, so
+ * every component with at least two members is solved separately (on the
+ * pool when there are several and `x->jobs` allows), each with its own
+ * search budget. Members without any candidate go straight to the singles.
+ *
+ * Without `required`, `state` is filled from scratch. Otherwise it holds a
+ * matching covering `required` on entry, which stays covered: a component
+ * where everybody requests once keeps it as is, since it is then already a
+ * maximum matching among those covering `required`.
+ */
+static void
+exact_solve (const matching_view *view,
+             matching_state *state,
+             uint64_t required,
+             struct pairup_options *x,
+             struct exact_stats *total)
+{
+    int component[MAX_MATCHES_LEN];
+    size_t size[MAX_MATCHES_LEN] = { 0 };
+    matching_state incumbent;
+
+    if (required)
+    {
+        incumbent = *state;
+    }
+    matching_state_init (state, view);
+    total->nodes = 0;
+    total->upper_bound = 0;
+    total->optimal = true;
+    total->elapsed_ms = 0;
+
+    size_t count = matching_components (view, component);
+    for (size_t v = 0; v < view->count; v++)
+    {
+        size[component[v]]++;
+    }
+
+    size_t n_tasks = 0;
+    for (size_t c = 0; c < count; c++)
+    {
+        if (size[c] > 1)
+        {
+            n_tasks++;
+        }
+    }
+
+    struct component_task *tasks = NULL;
+    if (n_tasks > 0)
+    {
+        tasks = (struct component_task *) malloc (n_tasks * sizeof(struct component_task));
+        if (!tasks)
+        {
+            fprintf (stderr, "Memory allocation failed for component_task\n");
+            if (required)
+            {
+                *state = incumbent;
+            }
+            return;
+        }
+    }
+
+    struct exact_budget budget = { 200000, 100, NULL };
+    if (x)
+    {
+        budget.node_limit = x->exact_node_limit;
+        budget.time_limit_ms = x->exact_time_limit_ms;
+        budget.stop = &x->stop;
+    }
+
+    for (size_t c = 0, t = 0; c < count; c++)
+    {
+        if (size[c] > 1)
+        {
+            struct component_task *task = &tasks[t++];
+            matching_view_subset (view, component, c, &task->view, task->vertex);
+            task->budget = budget;
+            task->required = 0;
+            if (!required)
+            {
+                continue;
+            }
+
+            /* The incumbent's pairs within this component, renumbered */
+            int local[MAX_MATCHES_LEN];
+            for (size_t i = 0; i < task->view.count; i++)
+            {
+                local[task->vertex[i]] = i;
+                if (required & ((uint64_t) 1 << task->vertex[i]))
+                {
+                    task->required |= (uint64_t) 1 << i;
+                }
+            }
+            matching_state_init (&task->state, &task->view);
+            for (size_t i = 0; i < incumbent.pairs; i++)
+            {
+                const struct matching_edge *e = &incumbent.edges[i];
+                if (component[e->u] == (int) c)
+                {
+                    matching_add (&task->state, local[e->u], local[e->v], e->time);
+                }
+            }
+        }
+    }
+
+    int jobs = (x && x->jobs > 0) ? x->jobs : pairup_pool_default_threads ();
+    if (jobs > (int) n_tasks)
+    {
+        jobs = n_tasks;
+    }
+
+    /* The priority sweep may already run this on a worker */
+    pairup_pool *pool = NULL;
+    if (jobs > 1 && !pairup_pool_in_worker ())
+    {
+        pool = pairup_pool_new (jobs);
+    }
+
+    for (size_t t = 0; t < n_tasks; t++)
+    {
+        if (!pool || !pairup_pool_submit (pool, component_solve, &tasks[t]))
+        {
+            component_solve (&tasks[t]);
+        }
+    }
+    if (pool)
+    {
+        pairup_pool_wait (pool);
+        pairup_pool_free (pool);
+    }
+
+    size_t searched = 0;
+    for (size_t t = 0; t < n_tasks; t++)
+    {
+        struct component_task *task = &tasks[t];
+        for (size_t i = 0; i < task->state.pairs; i++)
+        {
+            const struct matching_edge *e = &task->state.edges[i];
+            matching_add (state, task->vertex[e->u], task->vertex[e->v], e->time);
+        }
+
+        total->nodes += task->stats.nodes;
+        total->upper_bound += task->stats.upper_bound;
+        total->optimal = total->optimal && task->stats.optimal;
+        if (task->stats.elapsed_ms > total->elapsed_ms)
+        {
+            total->elapsed_ms = task->stats.elapsed_ms;
+        }
+        if (task->searched)
+        {
+            searched++;
+        }
+    }
+    free (tasks);
+
+    debug_printf (DEBUG_INFO, "\
+[ INFO    ] %zu components, %zu of them searched, %zu members without candidates.\n",
+count, searched, count - n_tasks);
+
+    if (searched > 0)
+    {
+        debug_printf (DEBUG_SUMMARY, "\
+[ SUMMARY ] Exact search: %zu pairs, upper bound %zu (gap %zu), %s after %zu nodes in %.1f ms\n",
+state->pairs, total->upper_bound, total->upper_bound - state->pairs,
+total->optimal ? "optimal" : "budget exhausted", total->nodes, total->elapsed_ms);
+    }
+}
+
+pair_result *
+pairup_optimal_priority (relation_graph *today,
+                         member *members[],
+                         struct pairup_options *x)
+{
+    matching_view view;
+    matching_state state;
+    struct exact_stats total;
+
+    matching_view_init (&view, today);
+    exact_solve (&view, &state, 0, x, &total);
+
+    /* Equal to the pairs once every component is solved to optimality */
+    pair_result *result = matching_to_result (&view, &state);
+    result->upper_bound = total.upper_bound;
+
+    return result;
+}
+
+static const struct pairup_algorithm ensure_algorithm = {
+    "ENSURE_LIST",                                // Maximum matching covering the ensured members.
+    NULL
+};
+
+/*
+ * Ensured members are covered one at a time, highest score first. Each one
+ * either augments the matching or takes the place of a covered member who
+ * is not ensured (`matching_cover_from`), so the members covered so far stay
+ * covered, and a member is only given up when no matching covers them
+ * together with the members covered before. The remaining free members are
+ * then augmented from, which never un-matches anybody: with one request
+ * each, that is a maximum matching among those covering the ensured members.
+ * 'Twice' requests need the exact search on top, with the covered members as
+ * a hard constraint, like OPTIMAL does without one (within the same budget).
+ */
+pair_result *
+pairup_ensure_priority (relation_graph *today,
+                        member *members[],
+                        struct pairup_options *x)
+{
+    matching_view view;
+    matching_state state;
+    int match[MAX_MATCHES_LEN];
+    int order[MAX_MATCHES_LEN];
+    size_t n_ensured = 0, n_covered = 0;
+
+    matching_view_init (&view, today);
+    for (size_t v = 0; v < view.count; v++)
+    {
+        match[v] = -1;
+        if (view.members[v]->ensure_score > 0)
+        {
+            order[n_ensured++] = v;
+        }
+    }
+
+    /* Highest ensure score first, sheet order between equal scores */
+    for (size_t i = 1; i < n_ensured; i++)
+    {
+        int v = order[i];
+        size_t j = i;
+        while (j > 0 && view.members[order[j - 1]]->ensure_score < view.members[v]->ensure_score)
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = v;
+    }
+
+    struct pairup_stop *stop = x ? &x->stop : NULL;
+    uint64_t covered = 0;
+    for (size_t i = 0; i < n_ensured && !pairup_should_stop (stop); i++)
+    {
+        int v = order[i];
+        if (match[v] != -1 || matching_cover_from (&view, match, v, covered))
+        {
+            covered |= (uint64_t) 1 << v;
+            n_covered++;
+            continue;
+        }
+
+        if (view.adjacent[v] == 0)
+        {
+            debug_printf (DEBUG_WARNING, "\
+[ WARNING ] '%s' cannot be ensured: nobody else is available at the same time.\n",
+view.members[v]->name);
+        }
+        else
+        {
+            debug_printf (DEBUG_WARNING, "\
+[ WARNING ] '%s' cannot be ensured together with the members listed before.\n",
+view.members[v]->name);
+        }
+    }
+
+    for (size_t v = 0; v < view.count && !pairup_should_stop (stop); v++)
+    {
+        if (match[v] == -1)
+        {
+            matching_augment_from (&view, match, v);
+        }
+    }
+
+    matching_from_match (&view, match, &state);
+    matching_fill_greedy (&view, &state);
+
+    struct exact_stats stats;
+    exact_solve (&view, &state, covered, x, &stats);
+
+    /* Listed members who did not fill in any slot are not in the graph at all */
+    for (size_t i = 0; i < MAX_MEMBERS_LEN; i++)
+    {
+        member *m = members[i];
+        if (!m || m->ensure_score <= 0)
+        {
+            continue;
+        }
+
+        bool in_graph = false;
+        for (size_t v = 0; v < view.count && !in_graph; v++)
+        {
+            in_graph = (view.members[v] == m);
+        }
+        if (!in_graph)
+        {
+            n_ensured++;
+            debug_printf (DEBUG_WARNING, "\
+[ WARNING ] '%s' cannot be ensured: no available time slot today.\n", m->name);
+        }
+    }
+
+    debug_printf (DEBUG_SUMMARY, "[ SUMMARY ] Ensured %zu of %zu listed members.\n",
+                  n_covered, n_ensured);
+
+    pair_result *result = matching_to_result (&view, &state);
+    result->algorithm_applied = (struct pairup_algorithm *) &ensure_algorithm;
+    result->unsettled = !stats.optimal;
+    return result;
+}
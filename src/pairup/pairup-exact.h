@@ -0,0 +1,40 @@
+#ifndef PAIRUP_EXACT_H
+#define PAIRUP_EXACT_H
+
+#include "pairup-matching.h"
+#include "pairup-types.h"
+
+/* Limits of one exact search, 0 means unlimited */
+struct exact_budget
+{
+    size_t node_limit;           // Maximum number of search nodes
+    int    time_limit_ms;        // Maximum wall-clock time
+    struct pairup_stop *stop;    // Deadline and cancellation of the whole solve (NULL: none)
+};
+
+/* What the exact search has proven */
+struct exact_stats
+{
+    size_t nodes;                // Search nodes expanded
+    size_t upper_bound;          // Proven upper bound on the number of pairs
+    bool   optimal;              // Whether the returned matching is proven optimal
+    double elapsed_ms;           // Wall-clock time spent
+};
+
+/*
+ * Branch-and-bound for the b-matching with slot exclusivity: every member
+ * takes up to `requests` partners, never the same partner twice, and never
+ * two partners in the same slot. Every vertex in `required` must take at
+ * least one partner, which the incumbent has to satisfy already.
+ *
+ * `best` holds the incumbent on entry and the best matching found on return,
+ * so running out of budget still yields a valid (possibly sub-optimal) result.
+ */
+void
+exact_search (const matching_view *view,
+              matching_state *best,
+              uint64_t required,
+              const struct exact_budget *budget,
+              struct exact_stats *stats);
+
+#endif  // PAIRUP_EXACT_H
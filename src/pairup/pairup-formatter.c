@@ -8,24 +8,19 @@
 #include "portable_wcwidth.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <locale.h>
 
-/*
- * TODO: Be able to retrieve single member's time suggestion from `result` object
- * because right now the following two function are just duplicated logic from
- * `pairup-algorithm.c`, which is really bad!
- */
+/* Label of a run of 30-min slots, merged into one string like 1900~2400 */
 static void
-append_range_string (sheet_t *worksheet,
-                      int start_col,
-                      int end_col,
-                      char *out,
-                      size_t out_size)
+format_slot_range (sheet_t *worksheet,
+                   const struct slot_range *range,
+                   char *out,
+                   size_t out_size)
 {
-    /* Merge consecutive 30-min slots into one string like 1900~2400 */
-    char *start_label = get_time_slot (worksheet, start_col);
-    char *end_label = get_time_slot (worksheet, end_col);
+    char *start_label = get_time_slot (worksheet, range->start);
+    char *end_label = get_time_slot (worksheet, range->end);
 
     const char *start_time = start_label ? start_label : "";
     const char *end_time = end_label ? end_label : "";
@@ -73,56 +68,6 @@ append_range_string (sheet_t *worksheet,
     }
 }
 
-static void
-collect_available_ranges (sheet_t *worksheet,
-                           int row,
-                           char ranges[][32],
-                           int *range_count)
-{
-    /* Scan availability columns and coalesce consecutive slots */
-    char cell[8];
-    int current_start = -1;
-    int last_col = -1;
-    int out_count = 0;
-
-    for (int j = FIELD_COL_START; j <= FIELD_COL_END; j++)
-    {
-        get_cell (worksheet, row, j, cell, sizeof(cell));
-        int available = is_available (cell);
-
-        if (available)
-        {
-            if (current_start == -1)
-            {
-                current_start = j;
-                last_col = j;
-            }
-            else if (j == last_col + 1)
-            {
-                last_col = j;
-            }
-            else
-            {
-                if (out_count < 64)
-                {
-                    append_range_string (worksheet, current_start, last_col, ranges[out_count], sizeof(ranges[out_count]));
-                    out_count++;
-                }
-                current_start = j;
-                last_col = j;
-            }
-        }
-    }
-
-    if (current_start != -1 && out_count < 64)
-    {
-        append_range_string (worksheet, current_start, last_col, ranges[out_count], sizeof(ranges[out_count]));
-        out_count++;
-    }
-
-    *range_count = out_count;
-}
-
 int
 get_display_width (const char *str)
 {
@@ -293,18 +238,10 @@ generate_graph_output_image (sheet *worksheet,
     printf ("Graph image has been generated to %s\n", filename);
 }
 
-void
-print_graph_to_file (sheet *worksheet,
-                     const char *filename)
+bool
+fprint_graph (FILE *file,
+              sheet *worksheet)
 {
-    printf("Output: %s\n", filename);
-    FILE *file = fopen (filename, "w");
-    if (file == NULL)
-    {
-        fprintf (stderr, "Error: cannot open file %s\n", filename);
-        return;
-    }
-
     fprintf (file, "graph G {\n");
     fprintf (file,"    /* File attributes */\n");
     fprintf (file,"    size=\"6,4\";\n    ratio=fill;\n");
@@ -313,8 +250,7 @@ print_graph_to_file (sheet *worksheet,
     if (graph == NULL)
     {
         fprintf (stderr, "Error: failed to generate graph\n");
-        fclose (file);
-        return;
+        return false;
     }
 
     fprintf (file, "\n    /* Node attributes */\n");
@@ -329,75 +265,43 @@ print_graph_to_file (sheet *worksheet,
 
     fprintf (file, "\n    /* Edge relations */\n");
 
-    size_t edge_count = 0;
-    for (size_t i = 0; i < graph->count; i++)
+    struct graph_edge *edges = NULL;
+    size_t n_edges = pairup_graph_edges (graph, &edges);
+    for (size_t i = 0; i < n_edges; i++)
     {
-        relation_t *relation = graph->relations[i];
-        edge_count += (relation->count - 1);
+        fprintf (file, "    \"%s\" -- \"%s\" [label=\"%s\" fontsize=7];\n",
+                 edges[i].a->name, edges[i].b->name, get_time_slot (worksheet, edges[i].time));
     }
 
-    typedef struct {
-        char *node1;
-        char *node2;
-        slot time;
-    } edge_t;
-
-    edge_t *printed_edges = (edge_t *) malloc (edge_count * sizeof(edge_t));
-    if (!printed_edges)
-    {
-        fprintf (stderr, "Error: failed to allocate memory for edges\n");
-        fclose (file);
-        return;
-    }
+    fprintf (file, "}\n");
 
-    int printed_count = 0;
+    free (edges);
+    free_relation_graph (graph);
+    return true;
+}
 
-    for (size_t i = 0; i < graph->count; i++)
+void
+print_graph_to_file (sheet *worksheet,
+                     const char *filename)
+{
+    printf("Output: %s\n", filename);
+    FILE *file = fopen (filename, "w");
+    if (file == NULL)
     {
-        relation_t *relation = graph->relations[i];
-        member *source = relation->candidates[0];
-
-        for (size_t j = 1; j < relation->count; j++)
-        {
-            member *target = relation->candidates[j];
-            slot time = relation->matched_slot[j];
-
-            int is_duplicate = 0;
-            for (int k = 0; k < printed_count; k++)
-            {
-                if ((strcmp(printed_edges[k].node1, source->name) == 0 &&
-                     strcmp(printed_edges[k].node2, target->name) == 0) ||
-                    (strcmp(printed_edges[k].node1, target->name) == 0 &&
-                     strcmp(printed_edges[k].node2, source->name) == 0))
-                {
-                    is_duplicate = 1;
-                    break;
-                }
-            }
-
-            if (!is_duplicate)
-            {
-                char *timestr = get_time_slot (worksheet, time);
-                fprintf (file, "    \"%s\" -- \"%s\" [label=\"%s\" fontsize=7];\n",
-                         source->name, target->name, timestr);
-
-                printed_edges[printed_count].node1 = source->name;
-                printed_edges[printed_count].node2 = target->name;
-                printed_edges[printed_count].time = time;
-                printed_count++;
-            }
-        }
+        fprintf (stderr, "Error: cannot open file %s\n", filename);
+        return;
     }
 
-    fprintf (file, "}\n");
+    /* A dense sheet has thousands of edges, write them in large chunks */
+    setvbuf (file, NULL, _IOFBF, 1 << 16);
 
+    bool written = fprint_graph (file, worksheet);
     fclose (file);
 
-    free (printed_edges);
-
-    printf ("Graph has been written to %s\n", filename);
-
-    free_relation_graph (graph);
+    if (written)
+    {
+        printf ("Graph has been written to %s\n", filename);
+    }
 }
 
 void
@@ -451,37 +355,69 @@ print_digraph_to_file (sheet *worksheet,
 }
 
 void
-print_result (sheet *worksheet,
-              pair_result *result)
+fprint_result (FILE *out,
+               sheet *worksheet,
+               pair_result *result)
 {
     if (result->pairs == 0)
     {
-        printf ("%s\n", NOPAIRS_SUGGESTION);
+        fprintf (out, "%s\n", NOPAIRS_SUGGESTION);
     }
     else
     {
-        printf ("%s\n", GREETING);
+        fprintf (out, "%s\n", GREETING);
         for (int i = 0; i < result->pairs; i++)
         {
             pair_t *pair = result->pair_list[i];
             char *time = get_time_slot (worksheet, pair->time);
-            printf ("@%s -- @%s (%s)\n", pair->a->name, pair->b->name, time);
+            fprintf (out, "@%s -- @%s (%s)\n", pair->a->name, pair->b->name, time);
         }
     }
 
-    printf ("\n");
-    printf ("As for\n");
+    fprintf (out, "\n");
+    fprintf (out, "As for\n");
 
     if (result->singles != 0)
     {
         for (int i = 0; i < result->singles; i++)
         {
             member_t *member = result->single_list[i];
-            printf("@%s (%s)\n", member->name, result->single_suggestion_time[i]);
+            fprintf (out, "@%s (", member->name);
+            for (size_t k = 0; k < result->single_range_count[i]; k++)
+            {
+                char range[32];
+                format_slot_range (worksheet, &result->single_ranges[i][k], range, sizeof(range));
+                fprintf (out, "%s%s", (k > 0) ? ", " : "", range);
+            }
+            fprintf (out, ")\n");
         }
     }
 
-    printf ("%s\n", ALTERNATIVES_FOR_NOT_MATCHED);
+    fprintf (out, "%s\n", ALTERNATIVES_FOR_NOT_MATCHED);
+}
+
+void
+print_result (sheet *worksheet,
+              pair_result *result)
+{
+    fprint_result (stdout, worksheet, result);
+}
+
+void
+write_result (FILE *out,
+              sheet *worksheet,
+              pair_result *result,
+              bool json_output)
+{
+    if (json_output)
+    {
+        fprint_result_json (out, worksheet, result);
+        fputc ('\n', out);
+    }
+    else
+    {
+        fprint_result (out, worksheet, result);
+    }
 }
 
 void
@@ -555,6 +491,29 @@ display_summary (pair_result *result)
 
 int debug_level = DEBUG_NONE;
 
+#if defined(_MSC_VER)
+#define PAIRUP_THREAD_LOCAL __declspec(thread)
+#else
+#define PAIRUP_THREAD_LOCAL __thread
+#endif
+
+/* Log of the library call running on this thread, NULL: `debug_level` and stdout */
+static PAIRUP_THREAD_LOCAL const struct pairup_log *current_log = NULL;
+
+const struct pairup_log *
+pairup_log_swap (const struct pairup_log *log)
+{
+    const struct pairup_log *previous = current_log;
+    current_log = log;
+    return previous;
+}
+
+const struct pairup_log *
+pairup_log_current (void)
+{
+    return current_log;
+}
+
 /* Debug function */
 // void
 // do_if_debug_level_is_greater (int level,
@@ -588,12 +547,23 @@ do_if_debug_level_is_greater (int level,
                               void *context,
                               const char *fmt, ...)
 {
-    if (level > debug_level)
+    const struct pairup_log *log = current_log;
+
+    if (level > (log ? log->level : debug_level))
     {
         return;
     }
 
-    if (fmt != NULL)
+    if (fmt != NULL && log && log->write)
+    {
+        char message[1024];
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(message, sizeof(message), fmt, args);
+        va_end(args);
+        log->write(log->user, level, message);
+    }
+    else if (fmt != NULL)
     {
         va_list args;
         va_start(args, fmt);
@@ -601,34 +571,35 @@ do_if_debug_level_is_greater (int level,
         va_end(args);
     }
 
-    if (fptr != NULL)
+    /* Callbacks print on their own, which a log handler could not capture */
+    if (fptr != NULL && !(log && log->write))
     {
         fptr(context);
     }
 }
 
-// cJSON *new_format_error_json_object ()
-// {
-//     cJSON *root = NULL;
-//     cJSON *result_paired_array = NULL;
-//     cJSON *result_single_array = NULL;
+cJSON *new_format_error_json_object (const char *message)
+{
+    cJSON *root = NULL;
+    cJSON *result_paired_array = NULL;
+    cJSON *result_single_array = NULL;
 
-//     debug_printf (DEBUG_INFO, "Initializing a JSON object with pair result ...\n");
-//     root = cJSON_CreateObject ();
-//     cJSON_AddNumberToObject (root, "exit_code", 1);
-//     cJSON_AddStringToObject (root, "exit_msg", "Invalid worksheet format");
-//     cJSON_AddStringToObject (root, "algorithm", "N/A");
-//     cJSON_AddNumberToObject (root, "n_successful_req", 0);
-//     cJSON_AddNumberToObject (root, "n_failed_req", 0);
+    debug_printf (DEBUG_INFO, "Initializing a JSON object with an error ...\n");
+    root = cJSON_CreateObject ();
+    cJSON_AddNumberToObject (root, "exit_code", 1);
+    cJSON_AddStringToObject (root, "exit_msg", message ? message : "Invalid worksheet format");
+    cJSON_AddStringToObject (root, "algorithm", "N/A");
+    cJSON_AddNumberToObject (root, "n_successful_req", 0);
+    cJSON_AddNumberToObject (root, "n_failed_req", 0);
 
-//     result_paired_array = cJSON_CreateArray ();
-//     result_single_array = cJSON_CreateArray ();
+    result_paired_array = cJSON_CreateArray ();
+    result_single_array = cJSON_CreateArray ();
 
-//     cJSON_AddItemToObject (root, "result_paired", result_paired_array);
-//     cJSON_AddItemToObject (root, "result_single", result_single_array);
+    cJSON_AddItemToObject (root, "result_paired", result_paired_array);
+    cJSON_AddItemToObject (root, "result_single", result_single_array);
 
-//     return root;
-// }
+    return root;
+}
 
 // init_result_json_object(void)
 cJSON *init_result_json_object (sheet_t *workseet,
@@ -645,6 +616,10 @@ cJSON *init_result_json_object (sheet_t *workseet,
     cJSON_AddStringToObject (root, "algorithm", r->algorithm_applied->name);
     cJSON_AddNumberToObject (root, "n_successful_req", r->pairs * 2);
     cJSON_AddNumberToObject (root, "n_failed_req", r->singles);
+    if (r->partial)
+    {
+        cJSON_AddTrueToObject (root, "partial");
+    }
 
     debug_printf (DEBUG_INFO, "Creating JSON array and filling with paired members ...\n");
     result_paired_array = cJSON_CreateArray ();
@@ -666,15 +641,12 @@ cJSON *init_result_json_object (sheet_t *workseet,
         cJSON *single_obj = cJSON_CreateObject ();
         cJSON_AddStringToObject (single_obj, "member", current->name);
 
-        /* Build merged availability ranges for this single */
-        char ranges[64][32];
-        int n_ranges = 0;
-        collect_available_ranges (workseet, current->id, ranges, &n_ranges);
-
         cJSON *range_array = cJSON_CreateArray ();
-        for (int k = 0; k < n_ranges; k++)
+        for (size_t k = 0; k < r->single_range_count[i]; k++)
         {
-            cJSON_AddItemToArray (range_array, cJSON_CreateString (ranges[k]));
+            char range[32];
+            format_slot_range (workseet, &r->single_ranges[i][k], range, sizeof(range));
+            cJSON_AddItemToArray (range_array, cJSON_CreateString (range));
         }
         cJSON_AddItemToObject (single_obj, "available_ranges", range_array);
         cJSON_AddItemToArray (result_single_array, single_obj);
@@ -686,6 +658,364 @@ cJSON *init_result_json_object (sheet_t *workseet,
     return root;
 }
 
+/*
+ * Streaming JSON writer. It emits exactly what `cJSON_Print` makes of the
+ * trees above (tab indentation, "key":<TAB>value, ", " between array
+ * elements, the same escapes), or what `cJSON_PrintUnformatted` makes of
+ * them when `compact`, straight into a FILE or a caller's buffer.
+ */
+struct json_sink
+{
+    FILE *file;                  // Written through, or
+    char *buffer;                // filled up to `size - 1` bytes and NUL-terminated
+    size_t size;
+    size_t length;               // Length of the whole document
+    bool compact;                // No whitespace at all
+};
+
+static void
+json_put (struct json_sink *sink,
+          const char *text,
+          size_t n)
+{
+    if (sink->file)
+    {
+        fwrite (text, 1, n, sink->file);
+    }
+    else if (sink->length + 1 < sink->size)
+    {
+        size_t room = sink->size - 1 - sink->length;
+        memcpy (sink->buffer + sink->length, text, (n < room) ? n : room);
+    }
+    sink->length += n;
+}
+
+static void
+json_put_text (struct json_sink *sink,
+               const char *text)
+{
+    json_put (sink, text, strlen (text));
+}
+
+static void
+json_put_string (struct json_sink *sink,
+                 const char *value)
+{
+    const unsigned char *run = (const unsigned char *) value;
+    const unsigned char *p = run;
+
+    json_put (sink, "\"", 1);
+    for (; *p; p++)
+    {
+        if (*p > 31 && *p != '\"' && *p != '\\')
+        {
+            continue;
+        }
+
+        char escape[8];
+        switch (*p)
+        {
+            case '\\': strcpy (escape, "\\\\"); break;
+            case '\"': strcpy (escape, "\\\""); break;
+            case '\b': strcpy (escape, "\\b"); break;
+            case '\f': strcpy (escape, "\\f"); break;
+            case '\n': strcpy (escape, "\\n"); break;
+            case '\r': strcpy (escape, "\\r"); break;
+            case '\t': strcpy (escape, "\\t"); break;
+            default:   snprintf (escape, sizeof(escape), "\\u%04x", *p); break;
+        }
+
+        json_put (sink, (const char *) run, p - run);
+        json_put_text (sink, escape);
+        run = p + 1;
+    }
+    json_put (sink, (const char *) run, p - run);
+    json_put (sink, "\"", 1);
+}
+
+/* `depth` tabs, then "key":<TAB> */
+static void
+json_put_key (struct json_sink *sink,
+              int depth,
+              const char *key)
+{
+    if (!sink->compact)
+    {
+        json_put (sink, "\t\t\t", depth);
+    }
+    json_put_string (sink, key);
+    json_put (sink, ":\t", sink->compact ? 1 : 2);
+}
+
+/* Between two members of an object */
+static void
+json_put_next (struct json_sink *sink)
+{
+    json_put (sink, ",\n", sink->compact ? 1 : 2);
+}
+
+/* Between two elements of an array */
+static void
+json_put_element (struct json_sink *sink)
+{
+    json_put (sink, ", ", sink->compact ? 1 : 2);
+}
+
+static void
+json_put_open (struct json_sink *sink)
+{
+    json_put (sink, "{\n", sink->compact ? 1 : 2);
+}
+
+/* Closing brace of an object whose members sit at `depth` */
+static void
+json_put_close (struct json_sink *sink,
+                int depth)
+{
+    if (!sink->compact)
+    {
+        json_put (sink, "\n\t\t\t", depth);
+    }
+    json_put (sink, "}", 1);
+}
+
+static void
+json_put_number (struct json_sink *sink,
+                 int value)
+{
+    char number[16];
+    json_put (sink, number, snprintf (number, sizeof(number), "%d", value));
+}
+
+/* The result document, or the error document of `message` when `r` is NULL, */
+/* led by the members describing `run` if there is one                       */
+static void
+json_write_document (struct json_sink *sink,
+                     const struct result_json_run *run,
+                     sheet_t *worksheet,
+                     result_t *r,
+                     const char *message)
+{
+    json_put_open (sink);
+    if (run)
+    {
+        char number[32];
+        json_put_key (sink, 1, "sheet");
+        json_put_string (sink, run->sheet);
+        json_put_next (sink);
+        json_put_key (sink, 1, "run");
+        json_put_number (sink, (int) run->run);
+        json_put_next (sink);
+        json_put_key (sink, 1, "seed");
+        json_put (sink, number, snprintf (number, sizeof(number), "%llu", (unsigned long long) run->seed));
+        json_put_next (sink);
+        json_put_key (sink, 1, "read_ms");
+        json_put (sink, number, snprintf (number, sizeof(number), "%.3f", run->read_ms));
+        json_put_next (sink);
+        json_put_key (sink, 1, "solve_ms");
+        json_put (sink, number, snprintf (number, sizeof(number), "%.3f", run->solve_ms));
+        json_put_next (sink);
+    }
+    json_put_key (sink, 1, "exit_code");
+    json_put_number (sink, r ? 0 : 1);
+    json_put_next (sink);
+    json_put_key (sink, 1, "exit_msg");
+    json_put_string (sink, r ? "Completed without error" : message ? message : "Invalid worksheet format");
+    json_put_next (sink);
+    json_put_key (sink, 1, "algorithm");
+    json_put_string (sink, r ? r->algorithm_applied->name : "N/A");
+    json_put_next (sink);
+    json_put_key (sink, 1, "n_successful_req");
+    json_put_number (sink, r ? (int) (r->pairs * 2) : 0);
+    json_put_next (sink);
+    json_put_key (sink, 1, "n_failed_req");
+    json_put_number (sink, r ? (int) r->singles : 0);
+    json_put_next (sink);
+    if (r && r->partial)
+    {
+        json_put_key (sink, 1, "partial");
+        json_put (sink, "true", 4);
+        json_put_next (sink);
+    }
+
+    json_put_key (sink, 1, "result_paired");
+    json_put (sink, "[", 1);
+    for (size_t i = 0; r && i < r->pairs; i++)
+    {
+        pair_t *current = r->pair_list[i];
+        if (i > 0)
+        {
+            json_put_element (sink);
+        }
+        json_put_open (sink);
+        json_put_key (sink, 3, "matched_time");
+        json_put_string (sink, get_time_slot (worksheet, current->time));
+        json_put_next (sink);
+        json_put_key (sink, 3, "member_a");
+        json_put_string (sink, current->a->name);
+        json_put_next (sink);
+        json_put_key (sink, 3, "member_b");
+        json_put_string (sink, current->b->name);
+        json_put_close (sink, 3);
+    }
+    json_put (sink, "]", 1);
+    json_put_next (sink);
+
+    json_put_key (sink, 1, "result_single");
+    json_put (sink, "[", 1);
+    for (size_t i = 0; r && i < r->singles; i++)
+    {
+        member_t *current = r->single_list[i];
+        if (i > 0)
+        {
+            json_put_element (sink);
+        }
+        json_put_open (sink);
+        json_put_key (sink, 3, "member");
+        json_put_string (sink, current->name);
+        json_put_next (sink);
+
+        json_put_key (sink, 3, "available_ranges");
+        json_put (sink, "[", 1);
+        for (size_t k = 0; k < r->single_range_count[i]; k++)
+        {
+            char range[32];
+            format_slot_range (worksheet, &r->single_ranges[i][k], range, sizeof(range));
+            if (k > 0)
+            {
+                json_put_element (sink);
+            }
+            json_put_string (sink, range);
+        }
+        json_put (sink, "]", 1);
+        json_put_close (sink, 3);
+    }
+    json_put (sink, "]", 1);
+    json_put_close (sink, 1);
+}
+
+bool
+fprint_result_json (FILE *out,
+                    sheet_t *worksheet,
+                    result_t *r)
+{
+    struct json_sink sink = { out, NULL, 0, 0, false };
+    json_write_document (&sink, NULL, worksheet, r, NULL);
+    return !ferror (out);
+}
+
+size_t
+snprint_result_json (char *buffer,
+                     size_t size,
+                     sheet_t *worksheet,
+                     result_t *r)
+{
+    struct json_sink sink = { NULL, buffer, size, 0, false };
+    json_write_document (&sink, NULL, worksheet, r, NULL);
+    if (size > 0)
+    {
+        buffer[(sink.length < size) ? sink.length : size - 1] = '\0';
+    }
+    return sink.length;
+}
+
+size_t
+snprint_error_json (char *buffer,
+                    size_t size,
+                    const char *message)
+{
+    struct json_sink sink = { NULL, buffer, size, 0, false };
+    json_write_document (&sink, NULL, NULL, NULL, message);
+    if (size > 0)
+    {
+        buffer[(sink.length < size) ? sink.length : size - 1] = '\0';
+    }
+    return sink.length;
+}
+
+bool
+fprint_result_ndjson (FILE *out,
+                      const struct result_json_run *run,
+                      sheet_t *worksheet,
+                      result_t *r,
+                      const char *message)
+{
+    struct json_sink sink = { out, NULL, 0, 0, true };
+    json_write_document (&sink, run, worksheet, r, message);
+    json_put (&sink, "\n", 1);
+    return !ferror (out);
+}
+
+char *
+new_result_json_string (sheet_t *worksheet,
+                        result_t *r)
+{
+    size_t length = snprint_result_json (NULL, 0, worksheet, r);
+    char *text = (char *) malloc (length + 1);
+    if (text)
+    {
+        snprint_result_json (text, length + 1, worksheet, r);
+    }
+    return text;
+}
+
+char *
+new_error_json_string (const char *message)
+{
+    size_t length = snprint_error_json (NULL, 0, message);
+    char *text = (char *) malloc (length + 1);
+    if (text)
+    {
+        snprint_error_json (text, length + 1, message);
+    }
+    return text;
+}
+
+static void
+copy_json_string (const cJSON *object,
+                  const char *key,
+                  char *out,
+                  size_t out_size)
+{
+    const char *value = cJSON_GetStringValue (cJSON_GetObjectItemCaseSensitive (object, key));
+
+    strncpy (out, value ? value : "", out_size - 1);
+    out[out_size - 1] = '\0';
+}
+
+struct previous_pair *
+parse_result_json_pairs (const cJSON *root,
+                         size_t *count)
+{
+    const cJSON *paired = cJSON_GetObjectItemCaseSensitive (root, "result_paired");
+    *count = 0;
+
+    if (!cJSON_IsArray (paired))
+    {
+        return NULL;
+    }
+
+    int size = cJSON_GetArraySize (paired);
+    struct previous_pair *previous = (struct previous_pair *) calloc (size > 0 ? size : 1,
+                                                                      sizeof(struct previous_pair));
+    if (!previous)
+    {
+        fprintf (stderr, "Memory allocation failed for previous_pair\n");
+        return NULL;
+    }
+
+    const cJSON *item = NULL;
+    cJSON_ArrayForEach (item, paired)
+    {
+        struct previous_pair *p = &previous[(*count)++];
+        copy_json_string (item, "member_a", p->a, sizeof(p->a));
+        copy_json_string (item, "member_b", p->b, sizeof(p->b));
+        copy_json_string (item, "matched_time", p->time, sizeof(p->time));
+    }
+
+    return previous;
+}
+
 void free_result_json_object (cJSON *root)
 {
     if (root) {
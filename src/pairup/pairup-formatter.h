@@ -30,14 +30,31 @@ your last weekend or sharing something interesting."
 void
 print_worksheet (sheet *worksheet);
 
+void
+fprint_result (FILE *out,
+               sheet *worksheet,
+               pair_result *result);
+
 void
 print_result (sheet *worksheet,
               pair_result *result);
 
+/* The whole output of one run: the JSON document, or the text of `fprint_result` */
+void
+write_result (FILE *out,
+              sheet *worksheet,
+              pair_result *result,
+              bool json_output);
+
 void
 generate_graph_output_image (sheet *worksheet,
                              const char *filename);
 
+/* The relation graph in DOT, false (after a message) if it cannot be built */
+bool
+fprint_graph (FILE *file,
+              sheet *worksheet);
+
 void
 print_graph_to_file (sheet *worksheet,
                      const char *filename);
@@ -79,6 +96,29 @@ display_graph (void *graph);
 
 extern int debug_level;
 
+/*
+ * Where the logs of one library call go. While a log is set on a thread
+ * (and on the pool workers running that thread's tasks) its level replaces
+ * `debug_level`, and messages go to `write` instead of stdout.
+ */
+typedef void (*pairup_log_fn) (void *user,
+                               int level,
+                               const char *message);
+
+struct pairup_log
+{
+    int level;
+    pairup_log_fn write;         // NULL: print to stdout
+    void *user;
+};
+
+/* Set the log of this thread, returning the previous one (NULL: none) */
+const struct pairup_log *
+pairup_log_swap (const struct pairup_log *log);
+
+const struct pairup_log *
+pairup_log_current (void);
+
 /* Callback function type */
 typedef void (*callback)(void *context);
 
@@ -92,11 +132,65 @@ void do_if_debug_level_is_greater (int level,
                                   void *context,
                                   const char *fmt, ...);
 
-// cJSON *new_format_error_json_object ();
+/* Same schema as a result, with exit_code 1 and `message` as exit_msg */
+cJSON *new_format_error_json_object (const char *message);
 
 cJSON *init_result_json_object (sheet_t *workseet,
                                 result_t *r);
 
+/*
+ * The document `cJSON_Print (init_result_json_object (...))` gives, byte for
+ * byte, written in one pass without building the tree. The `snprint_*`
+ * functions fill `buffer` like `snprintf`: they return the length of the
+ * whole document, so `(NULL, 0)` measures it.
+ */
+bool fprint_result_json (FILE *out,
+                         sheet_t *worksheet,
+                         result_t *r);
+
+size_t snprint_result_json (char *buffer,
+                            size_t size,
+                            sheet_t *worksheet,
+                            result_t *r);
+
+/* The document of `new_format_error_json_object (message)` */
+size_t snprint_error_json (char *buffer,
+                           size_t size,
+                           const char *message);
+
+/* What `--ndjson` reports about one run besides its result */
+struct result_json_run
+{
+    const char *sheet;           // Path of the sheet
+    size_t run;                  // Run number on that sheet
+    uint64_t seed;
+    double read_ms;              // Time spent reading the sheet
+    double solve_ms;             // Time spent pairing it up
+};
+
+/*
+ * One line of NDJSON: the document of `r` (or the error document of
+ * `message` when `r` is NULL) without any whitespace, led by the members of
+ * `run`: "sheet", "run", "seed", "read_ms" and "solve_ms".
+ */
+bool fprint_result_ndjson (FILE *out,
+                           const struct result_json_run *run,
+                           sheet_t *worksheet,
+                           result_t *r,
+                           const char *message);
+
+/* The same documents in memory of their own, free with `free` */
+char *new_result_json_string (sheet_t *worksheet,
+                              result_t *r);
+
+char *new_error_json_string (const char *message);
+
+/* Pairs listed in a result printed by `init_result_json_object`, */
+/* NULL if there is no "result_paired" array. Free with `free`     */
+struct previous_pair *
+parse_result_json_pairs (const cJSON *root,
+                         size_t *count);
+
 void free_result_json_object (cJSON *root);
 
 void free_result_json_string (char *str);
@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pairup-local.h"
+#include "pairup-algorithm.h"
+#include "pairup-formatter.h"
+#include "pairup-matching.h"
+#include "pairup-random.h"
+#include "pairup-types.h"
+
+/* Check the clock once every this many iterations */
+#define LOCAL_CLOCK_INTERVAL 256
+
+/* Probability of accepting a lost pair, multiplied by `LOCAL_COOLING` 100 times */
+#define LOCAL_START_ACCEPT   0.5
+#define LOCAL_COOLING        0.95
+#define LOCAL_COOLING_STEPS  100
+
+/* Iterations a broken pair may not be formed again */
+#define LOCAL_TABU_TENURE    16
+
+struct local_search
+{
+    const matching_view *view;
+    matching_state state;                            // Current matching
+    uint64_t partners[MAX_MATCHES_LEN];              // Vertices currently paired with `v`
+    uint64_t open;                                   // Vertices with requests left
+    size_t tabu[MAX_MATCHES_LEN][MAX_MATCHES_LEN];   // Iteration (u, v) is allowed again
+    size_t iteration;
+    pairup_random rng;
+    double accept;                                   // Probability of accepting a lost pair
+};
+
+static uint64_t
+local_random (struct local_search *s)
+{
+    return pairup_random_next (&s->rng);
+}
+
+static uint64_t
+local_random_below (struct local_search *s,
+                    uint64_t bound)
+{
+    return pairup_random_below (&s->rng, bound);
+}
+
+/* Index of a random bit set in `mask`, -1 if it is empty */
+static int
+local_pick (struct local_search *s,
+            uint64_t mask)
+{
+    int n = matching_popcount (mask);
+    if (n == 0)
+    {
+        return -1;
+    }
+
+    for (int k = local_random_below (s, n); k > 0; k--)
+    {
+        mask &= mask - 1;
+    }
+
+    int bit = 0;
+    while (!(mask & ((uint64_t) 1 << bit)))
+    {
+        bit++;
+    }
+
+    return bit;
+}
+
+static void
+local_update_open (struct local_search *s,
+                   int v)
+{
+    if (s->state.remain[v] > 0)
+    {
+        s->open |= (uint64_t) 1 << v;
+    }
+    else
+    {
+        s->open &= ~((uint64_t) 1 << v);
+    }
+}
+
+static void
+local_add (struct local_search *s,
+           int u,
+           int v,
+           slot time)
+{
+    matching_add (&s->state, u, v, time);
+    s->partners[u] |= (uint64_t) 1 << v;
+    s->partners[v] |= (uint64_t) 1 << u;
+    local_update_open (s, u);
+    local_update_open (s, v);
+}
+
+static struct matching_edge
+local_remove (struct local_search *s,
+              size_t i)
+{
+    struct matching_edge e = s->state.edges[i];
+
+    matching_remove (&s->state, i);
+    s->partners[e.u] &= ~((uint64_t) 1 << e.v);
+    s->partners[e.v] &= ~((uint64_t) 1 << e.u);
+    local_update_open (s, e.u);
+    local_update_open (s, e.v);
+
+    return e;
+}
+
+/* Pair `u` with a random open partner outside `exclude`: one pair more */
+static bool
+local_form (struct local_search *s,
+            int u,
+            uint64_t exclude)
+{
+    const matching_view *view = s->view;
+
+    if (s->state.remain[u] <= 0)
+    {
+        return false;
+    }
+
+    uint64_t candidates = view->adjacent[u] & s->open & ~s->partners[u] & ~exclude;
+    slot_mask free_u = view->slots[u] & ~s->state.used[u];
+    uint64_t options = 0;
+
+    for (size_t w = 0; w < view->count; w++)
+    {
+        if (!(candidates & ((uint64_t) 1 << w)))
+        {
+            continue;
+        }
+
+        if ((free_u & view->slots[w] & ~s->state.used[w]) && s->tabu[u][w] <= s->iteration)
+        {
+            options |= (uint64_t) 1 << w;
+        }
+    }
+
+    int w = local_pick (s, options);
+    if (w < 0)
+    {
+        return false;
+    }
+
+    slot_mask common = free_u & view->slots[w] & ~s->state.used[w];
+    local_add (s, u, w, FIELD_COL_START + local_pick (s, common));
+    return true;
+}
+
+/* Move a random pair to another slot both members still have free: no change */
+static bool
+local_move_slot (struct local_search *s)
+{
+    const matching_view *view = s->view;
+    struct matching_edge *e = &s->state.edges[local_random_below (s, s->state.pairs)];
+
+    slot_mask common = view->slots[e->u] & ~s->state.used[e->u] &
+                       view->slots[e->v] & ~s->state.used[e->v];
+    int k = local_pick (s, common);
+    if (k < 0)
+    {
+        return false;
+    }
+
+    slot time = FIELD_COL_START + k;
+    s->state.used[e->u] = (s->state.used[e->u] & ~SLOT_BIT(e->time)) | SLOT_BIT(time);
+    s->state.used[e->v] = (s->state.used[e->v] & ~SLOT_BIT(e->time)) | SLOT_BIT(time);
+    e->time = time;
+    return true;
+}
+
+/* Replace one end of a random pair with another partner: no change */
+static bool
+local_swap_partner (struct local_search *s)
+{
+    struct matching_edge e = local_remove (s, local_random_below (s, s->state.pairs));
+    int keep = e.u, drop = e.v;
+
+    if (local_random (s) & 1)
+    {
+        keep = e.v;
+        drop = e.u;
+    }
+
+    if (local_form (s, keep, (uint64_t) 1 << drop))
+    {
+        return true;
+    }
+
+    local_add (s, e.u, e.v, e.time);
+    return false;
+}
+
+/* Break a random pair and re-form both ends elsewhere: one pair less at worst */
+static bool
+local_break_reform (struct local_search *s)
+{
+    struct matching_edge e = local_remove (s, local_random_below (s, s->state.pairs));
+    size_t until_uv = s->tabu[e.u][e.v];
+
+    s->tabu[e.u][e.v] = s->tabu[e.v][e.u] = s->iteration + LOCAL_TABU_TENURE;
+
+    int formed = local_form (s, e.u, (uint64_t) 1 << e.v);
+    formed += local_form (s, e.v, (uint64_t) 1 << e.u);
+
+    if (formed >= 1 || pairup_random_unit (&s->rng) < s->accept)
+    {
+        return true;
+    }
+
+    /* Rejected: nothing was formed, so only the broken pair comes back */
+    s->tabu[e.u][e.v] = s->tabu[e.v][e.u] = until_uv;
+    local_add (s, e.u, e.v, e.time);
+    return false;
+}
+
+void
+local_search (const matching_view *view,
+              matching_state *best,
+              size_t target,
+              uint64_t seed,
+              const struct local_budget *budget,
+              struct local_stats *stats)
+{
+    struct local_search *s = (struct local_search *) calloc (1, sizeof(struct local_search));
+    double start = pairup_clock_ms ();
+
+    stats->iterations = 0;
+    stats->accepted = 0;
+    stats->last_improvement = 0;
+    stats->elapsed_ms = 0;
+
+    if (!s)
+    {
+        fprintf (stderr, "Memory allocation failed for local_search\n");
+        return;
+    }
+
+    size_t limit = budget ? budget->iterations : 0;
+    double deadline = (budget && budget->time_limit_ms > 0) ? start + budget->time_limit_ms : 0;
+
+    /* Never run unbounded: no limit at all falls back to the default iterations */
+    if (!limit && deadline == 0)
+    {
+        limit = 100000;
+    }
+
+    size_t cooling_interval = limit ? limit / LOCAL_COOLING_STEPS : 1000;
+    if (cooling_interval == 0)
+    {
+        cooling_interval = 1;
+    }
+
+    s->view = view;
+    pairup_random_init (&s->rng, seed, PAIRUP_STREAM (PAIRUP_STREAM_LOCAL, 0));
+    s->accept = LOCAL_START_ACCEPT;
+    matching_state_init (&s->state, view);
+    for (size_t v = 0; v < view->count; v++)
+    {
+        local_update_open (s, v);
+    }
+    for (size_t i = 0; i < best->pairs; i++)
+    {
+        local_add (s, best->edges[i].u, best->edges[i].v, best->edges[i].time);
+    }
+
+    while (best->pairs < target)
+    {
+        if (limit && s->iteration >= limit)
+        {
+            break;
+        }
+        if (deadline > 0 && s->iteration % LOCAL_CLOCK_INTERVAL == 0 &&
+            pairup_clock_ms () >= deadline)
+        {
+            break;
+        }
+        if (budget && s->iteration % LOCAL_CLOCK_INTERVAL == 0 &&
+            pairup_should_stop (budget->stop))
+        {
+            break;
+        }
+
+        s->iteration++;
+        if (s->iteration % cooling_interval == 0)
+        {
+            s->accept *= LOCAL_COOLING;
+        }
+
+        bool applied;
+        uint64_t move = local_random_below (s, 100);
+
+        if (move < 35 || s->state.pairs == 0)
+        {
+            int u = local_pick (s, s->open);
+            applied = (u >= 0) && local_form (s, u, 0);
+        }
+        else if (move < 55)
+        {
+            applied = local_move_slot (s);
+        }
+        else if (move < 80)
+        {
+            applied = local_swap_partner (s);
+        }
+        else
+        {
+            applied = local_break_reform (s);
+        }
+
+        if (applied)
+        {
+            stats->accepted++;
+        }
+
+        if (s->state.pairs > best->pairs)
+        {
+            *best = s->state;
+            stats->last_improvement = s->iteration;
+
+            debug_printf (DEBUG_INFO, "[ INFO    ] Local search: %zu pairs at iteration %zu (%.1f ms)\n",
+                          best->pairs, s->iteration, pairup_clock_ms () - start);
+        }
+    }
+
+    stats->iterations = s->iteration;
+    stats->elapsed_ms = pairup_clock_ms () - start;
+    free (s);
+}
+
+/* Greedy start in sheet order, improved by simulated annealing */
+pair_result *
+pairup_local_search_priority (relation_graph *today,
+                              member *members[],
+                              struct pairup_options *x)
+{
+    matching_view view;
+    matching_state state;
+    struct local_budget budget = { 100000, 50, NULL };
+    struct local_stats stats;
+    uint64_t seed = 0;
+
+    if (x)
+    {
+        budget.iterations = x->local_iterations;
+        budget.time_limit_ms = x->local_time_limit_ms;
+        budget.stop = &x->stop;
+        seed = x->seed;
+    }
+
+    matching_view_init (&view, today);
+    matching_state_init (&state, &view);
+    matching_fill_greedy (&view, &state);
+
+    size_t start_pairs = state.pairs;
+    local_search (&view, &state, matching_upper_bound (&view), seed, &budget, &stats);
+
+    debug_printf (DEBUG_SUMMARY, "\
+[ SUMMARY ] Local search: %zu -> %zu pairs, %zu of %zu moves accepted in %.1f ms, last improvement at iteration %zu\n",
+start_pairs, state.pairs, stats.accepted, stats.iterations, stats.elapsed_ms, stats.last_improvement);
+
+    return matching_to_result (&view, &state);
+}
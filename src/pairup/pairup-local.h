@@ -0,0 +1,46 @@
+#ifndef PAIRUP_LOCAL_H
+#define PAIRUP_LOCAL_H
+
+#include "pairup-matching.h"
+#include "pairup-types.h"
+
+/* Limits of one local search, 0 means unlimited (but not both at once) */
+struct local_budget
+{
+    size_t iterations;           // Maximum number of moves tried
+    int    time_limit_ms;        // Maximum wall-clock time
+    struct pairup_stop *stop;    // Deadline and cancellation of the whole solve (NULL: none)
+};
+
+/* How the local search went */
+struct local_stats
+{
+    size_t iterations;           // Moves tried
+    size_t accepted;             // Moves applied
+    size_t last_improvement;     // Iteration that found the returned matching
+    double elapsed_ms;           // Wall-clock time spent
+};
+
+/*
+ * Simulated annealing over b-matchings with slot exclusivity.
+ *
+ * Every iteration tries one move: form a new pair, move a pair to another
+ * slot, swap one end of a pair for another partner, or break a pair and
+ * re-form both ends elsewhere. Moves are scored from the slot masks and
+ * remaining requests of the members involved only. Worsening moves are
+ * accepted with a probability that cools down over the iterations, and a
+ * broken pair stays tabu for a few iterations so it is not re-formed at once.
+ *
+ * `best` holds the starting matching on entry and the best matching found on
+ * return. The search stops early once `target` pairs are reached, and the
+ * same `seed` always makes the same moves.
+ */
+void
+local_search (const matching_view *view,
+              matching_state *best,
+              size_t target,
+              uint64_t seed,
+              const struct local_budget *budget,
+              struct local_stats *stats);
+
+#endif  // PAIRUP_LOCAL_H
@@ -0,0 +1,841 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pairup-matching.h"
+#include "pairup-algorithm.h"
+#include "pairup-formatter.h"
+#include "pairup-types.h"
+
+/*****************************  VIEW AND STATE (START)  *******************************/
+
+void
+matching_view_init (matching_view *view,
+                    relation_graph *today)
+{
+    view->count = today->count;
+
+    for (size_t i = 0; i < today->count; i++)
+    {
+        member *m = today->relations[i]->candidates[0];
+        view->members[i] = m;
+        view->capacity[i] = (int) m->requests;
+        view->slots[i] = m->slots;
+        view->adjacent[i] = 0;
+    }
+
+    for (size_t u = 0; u < view->count; u++)
+    {
+        for (size_t v = u + 1; v < view->count; v++)
+        {
+            if (view->slots[u] & view->slots[v])
+            {
+                view->adjacent[u] |= (uint64_t) 1 << v;
+                view->adjacent[v] |= (uint64_t) 1 << u;
+            }
+        }
+    }
+}
+
+void
+matching_state_init (matching_state *state,
+                     const matching_view *view)
+{
+    state->pairs = 0;
+    for (size_t v = 0; v < view->count; v++)
+    {
+        state->remain[v] = view->capacity[v];
+        state->used[v] = 0;
+    }
+}
+
+slot_mask
+matching_free_slots (const matching_view *view,
+                     const matching_state *state,
+                     int u,
+                     int v)
+{
+    if (u == v || state->remain[u] <= 0 || state->remain[v] <= 0)
+    {
+        return 0;
+    }
+
+    return (view->slots[u] & ~state->used[u]) &
+           (view->slots[v] & ~state->used[v]);
+}
+
+bool
+matching_has_edge (const matching_state *state,
+                   int u,
+                   int v)
+{
+    for (size_t i = 0; i < state->pairs; i++)
+    {
+        const struct matching_edge *e = &state->edges[i];
+        if ((e->u == u && e->v == v) || (e->u == v && e->v == u))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+matching_add (matching_state *state,
+              int u,
+              int v,
+              slot time)
+{
+    if (state->pairs >= MAX_MATCHES_LEN)
+    {
+        return;
+    }
+
+    struct matching_edge *e = &state->edges[state->pairs++];
+    e->u = u;
+    e->v = v;
+    e->time = time;
+
+    state->remain[u]--;
+    state->remain[v]--;
+    state->used[u] |= SLOT_BIT(time);
+    state->used[v] |= SLOT_BIT(time);
+}
+
+void
+matching_remove (matching_state *state,
+                 size_t i)
+{
+    struct matching_edge *e = &state->edges[i];
+
+    state->remain[e->u]++;
+    state->remain[e->v]++;
+    state->used[e->u] &= ~SLOT_BIT(e->time);
+    state->used[e->v] &= ~SLOT_BIT(e->time);
+
+    state->edges[i] = state->edges[--state->pairs];
+}
+
+slot
+matching_first_slot (slot_mask mask)
+{
+    for (int k = 0; k < MAX_SLOTS_LEN; k++)
+    {
+        if (mask & ((slot_mask) 1 << k))
+        {
+            return FIELD_COL_START + k;
+        }
+    }
+
+    return -1;
+}
+
+void
+matching_fill_greedy (const matching_view *view,
+                      matching_state *state)
+{
+    for (size_t u = 0; u < view->count; u++)
+    {
+        for (size_t v = u + 1; v < view->count && state->remain[u] > 0; v++)
+        {
+            slot_mask common = matching_free_slots (view, state, u, v);
+            if (common && !matching_has_edge (state, u, v))
+            {
+                matching_add (state, u, v, matching_first_slot (common));
+            }
+        }
+    }
+}
+
+pair_result *
+matching_to_result (const matching_view *view,
+                    const matching_state *state)
+{
+    pair_result *result = new_pair_result (0, 0, 0);
+    if (result == NULL)
+    {
+        return NULL;
+    }
+
+    result->total_requests = 0;
+
+    for (size_t i = 0; i < state->pairs; i++)
+    {
+        const struct matching_edge *e = &state->edges[i];
+
+        pair *pair = new_pair ();
+        pair->a = view->members[e->u];
+        pair->b = view->members[e->v];
+        pair->time = e->time;
+        result->pair_list[result->pairs++] = pair;
+    }
+
+    for (size_t v = 0; v < view->count; v++)
+    {
+        result->total_requests += view->capacity[v];
+
+        if (state->remain[v] != 0)
+        {
+            result->single_list[result->singles++] = view->members[v];
+        }
+
+        result->member_list[result->member++] = view->members[v];
+    }
+
+    return result;
+}
+
+int
+matching_popcount (uint64_t x)
+{
+    int count = 0;
+    while (x)
+    {
+        x &= x - 1;
+        count++;
+    }
+    return count;
+}
+
+static int
+components_find (int parent[],
+                 int v)
+{
+    while (parent[v] != v)
+    {
+        parent[v] = parent[parent[v]];
+        v = parent[v];
+    }
+    return v;
+}
+
+size_t
+matching_components (const matching_view *view,
+                     int component[])
+{
+    int parent[MAX_MATCHES_LEN];
+    int label[MAX_MATCHES_LEN];
+    size_t count = 0;
+
+    for (size_t v = 0; v < view->count; v++)
+    {
+        parent[v] = v;
+        label[v] = -1;
+    }
+
+    for (size_t u = 0; u < view->count; u++)
+    {
+        for (size_t v = u + 1; v < view->count; v++)
+        {
+            if (view->adjacent[u] & ((uint64_t) 1 << v))
+            {
+                int ru = components_find (parent, u);
+                int rv = components_find (parent, v);
+                if (ru != rv)
+                {
+                    parent[rv] = ru;
+                }
+            }
+        }
+    }
+
+    for (size_t v = 0; v < view->count; v++)
+    {
+        int root = components_find (parent, v);
+        if (label[root] == -1)
+        {
+            label[root] = count++;
+        }
+        component[v] = label[root];
+    }
+
+    return count;
+}
+
+void
+matching_view_subset (const matching_view *view,
+                      const int component[],
+                      int label,
+                      matching_view *sub,
+                      int vertex[])
+{
+    int local[MAX_MATCHES_LEN];
+
+    sub->count = 0;
+    for (size_t v = 0; v < view->count; v++)
+    {
+        local[v] = -1;
+        if (component[v] == label)
+        {
+            local[v] = sub->count;
+            vertex[sub->count] = v;
+            sub->members[sub->count] = view->members[v];
+            sub->capacity[sub->count] = view->capacity[v];
+            sub->slots[sub->count] = view->slots[v];
+            sub->count++;
+        }
+    }
+
+    for (size_t i = 0; i < sub->count; i++)
+    {
+        uint64_t adjacent = view->adjacent[vertex[i]];
+        sub->adjacent[i] = 0;
+        for (size_t w = 0; w < view->count; w++)
+        {
+            if ((adjacent & ((uint64_t) 1 << w)) && local[w] >= 0)
+            {
+                sub->adjacent[i] |= (uint64_t) 1 << local[w];
+            }
+        }
+    }
+}
+
+size_t
+matching_upper_bound (const matching_view *view)
+{
+    int component[MAX_MATCHES_LEN];
+    size_t capacity[MAX_MATCHES_LEN] = { 0 };
+    size_t bound = 0;
+
+    size_t count = matching_components (view, component);
+
+    for (size_t v = 0; v < view->count; v++)
+    {
+        int cap = view->capacity[v];
+        int partners = matching_popcount (view->adjacent[v]);
+        int slots = matching_popcount (view->slots[v]);
+
+        if (partners < cap) cap = partners;
+        if (slots < cap) cap = slots;
+        capacity[component[v]] += cap;
+    }
+
+    for (size_t c = 0; c < count; c++)
+    {
+        bound += capacity[c] / 2;
+    }
+
+    return bound;
+}
+
+/******************************  VIEW AND STATE (END)  ********************************/
+
+/*****************************  EDMONDS' BLOSSOM (START)  *****************************/
+
+/*
+ * Classic O(V^3) formulation: grow an alternating BFS tree from `root`,
+ * contract odd cycles (blossoms) by relabelling their `base`, and walk the
+ * `parent` links back once a free vertex is reached. With at most 64
+ * vertices this is a few microseconds per sheet.
+ */
+struct blossom_search
+{
+    int n;
+    const int *match;
+    int parent[MAX_MATCHES_LEN];
+    int base[MAX_MATCHES_LEN];
+    bool used[MAX_MATCHES_LEN];
+    bool in_blossom[MAX_MATCHES_LEN];
+    int queue[MAX_MATCHES_LEN];
+    int head;
+    int tail;
+};
+
+static int
+blossom_lca (struct blossom_search *s,
+             int a,
+             int b)
+{
+    bool seen[MAX_MATCHES_LEN] = { false };
+
+    for (;;)
+    {
+        a = s->base[a];
+        seen[a] = true;
+        if (s->match[a] == -1)
+        {
+            break;
+        }
+        a = s->parent[s->match[a]];
+    }
+
+    for (;;)
+    {
+        b = s->base[b];
+        if (seen[b])
+        {
+            return b;
+        }
+        b = s->parent[s->match[b]];
+    }
+}
+
+static void
+blossom_mark_path (struct blossom_search *s,
+                   int v,
+                   int b,
+                   int child)
+{
+    while (s->base[v] != b)
+    {
+        s->in_blossom[s->base[v]] = true;
+        s->in_blossom[s->base[s->match[v]]] = true;
+        s->parent[v] = child;
+        child = s->match[v];
+        v = s->parent[s->match[v]];
+    }
+}
+
+static int
+blossom_find_path (struct blossom_search *s,
+                   const matching_view *view,
+                   int root)
+{
+    for (int i = 0; i < s->n; i++)
+    {
+        s->used[i] = false;
+        s->parent[i] = -1;
+        s->base[i] = i;
+    }
+
+    s->used[root] = true;
+    s->head = s->tail = 0;
+    s->queue[s->tail++] = root;
+
+    while (s->head < s->tail)
+    {
+        int v = s->queue[s->head++];
+
+        for (int to = 0; to < s->n; to++)
+        {
+            if (!(view->adjacent[v] & ((uint64_t) 1 << to)) ||
+                s->base[v] == s->base[to] ||
+                s->match[v] == to)
+            {
+                continue;
+            }
+
+            if (to == root ||
+                (s->match[to] != -1 && s->parent[s->match[to]] != -1))
+            {
+                /* Odd cycle: contract the blossom into its base */
+                int current_base = blossom_lca (s, v, to);
+                memset (s->in_blossom, 0, sizeof(s->in_blossom));
+                blossom_mark_path (s, v, current_base, to);
+                blossom_mark_path (s, to, current_base, v);
+
+                for (int i = 0; i < s->n; i++)
+                {
+                    if (s->in_blossom[s->base[i]])
+                    {
+                        s->base[i] = current_base;
+                        if (!s->used[i])
+                        {
+                            s->used[i] = true;
+                            s->queue[s->tail++] = i;
+                        }
+                    }
+                }
+            }
+            else if (s->parent[to] == -1)
+            {
+                s->parent[to] = v;
+                if (s->match[to] == -1)
+                {
+                    return to;
+                }
+
+                s->used[s->match[to]] = true;
+                s->queue[s->tail++] = s->match[to];
+            }
+        }
+    }
+
+    return -1;
+}
+
+bool
+matching_augment_from (const matching_view *view,
+                       int match[],
+                       int root)
+{
+    struct blossom_search s;
+
+    if (match[root] != -1)
+    {
+        return false;
+    }
+
+    s.n = (int) view->count;
+    s.match = match;
+
+    int v = blossom_find_path (&s, view, root);
+    if (v == -1)
+    {
+        return false;
+    }
+
+    /* Flip the alternating path from `v` back to `root` */
+    while (v != -1)
+    {
+        int pv = s.parent[v];
+        int ppv = match[pv];
+        match[v] = pv;
+        match[pv] = v;
+        v = ppv;
+    }
+
+    return true;
+}
+
+bool
+matching_cover_from (const matching_view *view,
+                     int match[],
+                     int root,
+                     uint64_t keep)
+{
+    struct blossom_search s;
+
+    if (match[root] != -1)
+    {
+        return false;
+    }
+
+    s.n = (int) view->count;
+    s.match = match;
+
+    int v = blossom_find_path (&s, view, root);
+    if (v == -1)
+    {
+        /*
+         * No free vertex to reach, but every outer vertex of the tree is at
+         * the end of an even alternating path from `root`: flipping the path
+         * to one that is not kept covers `root` and uncovers only that one.
+         * Inside a blossom the `parent` links left by the contraction lead
+         * around the cycle, exactly as they do for an augmenting path.
+         */
+        for (int w = 0; w < s.n && v == -1; w++)
+        {
+            if (w != root && s.used[w] && match[w] != -1 &&
+                !(keep & ((uint64_t) 1 << w)))
+            {
+                v = match[w];
+                match[w] = -1;
+            }
+        }
+        if (v == -1)
+        {
+            return false;
+        }
+    }
+
+    /* Flip the alternating path from `v` back to `root` */
+    while (v != -1)
+    {
+        int pv = s.parent[v];
+        int ppv = match[pv];
+        match[v] = pv;
+        match[pv] = v;
+        v = ppv;
+    }
+
+    return true;
+}
+
+size_t
+matching_maximum (const matching_view *view,
+                  int match[])
+{
+    size_t pairs = 0;
+
+    for (size_t v = 0; v < view->count; v++)
+    {
+        match[v] = -1;
+    }
+
+    for (size_t v = 0; v < view->count; v++)
+    {
+        if (match[v] == -1 && matching_augment_from (view, match, v))
+        {
+            pairs++;
+        }
+    }
+
+    return pairs;
+}
+
+/******************************  EDMONDS' BLOSSOM (END)  ******************************/
+
+/****************************  AUGMENTING PATHS (START)  ******************************/
+
+/*
+ * Alternating BFS tree: `outer` vertices look for a new partner, `inner`
+ * vertices are reached by a new pair and continue along one of their
+ * existing pairs, which gets dissolved. Each vertex appears at most once on
+ * a path, so it drops at most one existing pair and all slot checks are
+ * local to the vertex.
+ */
+struct augment_search
+{
+    int kind[MAX_MATCHES_LEN];           // 0: unvisited, 1: outer, 2: inner
+    int parent[MAX_MATCHES_LEN];         // Previous vertex on the path
+    int dropped[MAX_MATCHES_LEN];        // Outer: existing pair it leaves, -1 if none
+    int queue[MAX_MATCHES_LEN];
+};
+
+#define AUGMENT_OUTER 1
+#define AUGMENT_INNER 2
+
+/* Slots `v` can offer to a new pair once it leaves the pair `dropped` */
+static slot_mask
+augment_free_slots (const matching_view *view,
+                    const matching_state *state,
+                    int v,
+                    int dropped)
+{
+    slot_mask used = state->used[v];
+    if (dropped >= 0)
+    {
+        used &= ~SLOT_BIT(state->edges[dropped].time);
+    }
+    return view->slots[v] & ~used;
+}
+
+static void
+augment_apply (const matching_view *view,
+               matching_state *state,
+               struct augment_search *s,
+               int end)
+{
+    int drop[MAX_MATCHES_LEN];
+    int join_a[MAX_MATCHES_LEN], join_b[MAX_MATCHES_LEN];
+    int n_drop = 0, n_join = 0;
+
+    /* Walk back: end <- outer <- inner <- outer ... <- root */
+    int y = end;
+    while (y != -1)
+    {
+        int z = s->parent[y];
+        join_a[n_join] = z;
+        join_b[n_join] = y;
+        n_join++;
+
+        if (s->dropped[z] >= 0)
+        {
+            drop[n_drop++] = s->dropped[z];
+        }
+        y = (s->dropped[z] >= 0) ? s->parent[z] : -1;
+    }
+
+    /* Remove from the back so the remaining indices stay valid */
+    for (int i = 0; i < n_drop; i++)
+    {
+        for (int j = i + 1; j < n_drop; j++)
+        {
+            if (drop[j] > drop[i])
+            {
+                int t = drop[i];
+                drop[i] = drop[j];
+                drop[j] = t;
+            }
+        }
+    }
+    for (int i = 0; i < n_drop; i++)
+    {
+        matching_remove (state, drop[i]);
+    }
+
+    for (int i = n_join - 1; i >= 0; i--)
+    {
+        int u = join_a[i], v = join_b[i];
+        slot_mask common = augment_free_slots (view, state, u, -1) &
+                           augment_free_slots (view, state, v, -1);
+        matching_add (state, u, v, matching_first_slot (common));
+    }
+}
+
+static bool
+augment_from (const matching_view *view,
+              matching_state *state,
+              int root)
+{
+    struct augment_search s;
+    int head = 0, tail = 0;
+
+    for (size_t v = 0; v < view->count; v++)
+    {
+        s.kind[v] = 0;
+        s.parent[v] = -1;
+        s.dropped[v] = -1;
+    }
+
+    s.kind[root] = AUGMENT_OUTER;
+    s.queue[tail++] = root;
+
+    while (head < tail)
+    {
+        int z = s.queue[head++];
+        slot_mask free_z = augment_free_slots (view, state, z, s.dropped[z]);
+
+        for (size_t y = 0; y < view->count; y++)
+        {
+            if (!(view->adjacent[z] & ((uint64_t) 1 << y)) ||
+                s.kind[y] != 0 ||
+                !(free_z & view->slots[y]) ||
+                matching_has_edge (state, z, y))
+            {
+                continue;
+            }
+
+            /* A member with requests left closes the path */
+            if (state->remain[y] > 0 &&
+                (free_z & augment_free_slots (view, state, y, -1)))
+            {
+                s.parent[y] = z;
+                augment_apply (view, state, &s, y);
+                return true;
+            }
+
+            /* Otherwise continue along one of y's existing pairs */
+            for (size_t i = 0; i < state->pairs; i++)
+            {
+                const struct matching_edge *e = &state->edges[i];
+                if (e->u != (int) y && e->v != (int) y)
+                {
+                    continue;
+                }
+
+                int w = (e->u == (int) y) ? e->v : e->u;
+                if (s.kind[w] != 0 ||
+                    !(free_z & augment_free_slots (view, state, y, i)))
+                {
+                    continue;
+                }
+
+                s.kind[y] = AUGMENT_INNER;
+                s.parent[y] = z;
+                s.kind[w] = AUGMENT_OUTER;
+                s.parent[w] = y;
+                s.dropped[w] = i;
+                s.queue[tail++] = w;
+            }
+        }
+    }
+
+    return false;
+}
+
+size_t
+matching_augment (const matching_view *view,
+                  matching_state *state,
+                  struct pairup_stop *stop)
+{
+    size_t won = 0;
+    bool improved = true;
+
+    while (improved)
+    {
+        improved = false;
+        for (size_t v = 0; v < view->count; v++)
+        {
+            if (pairup_should_stop (stop))
+            {
+                return won;
+            }
+
+            if (state->remain[v] > 0 && augment_from (view, state, v))
+            {
+                won++;
+                improved = true;
+            }
+        }
+    }
+
+    return won;
+}
+
+void
+matching_from_result (const matching_view *view,
+                      const pair_result *result,
+                      matching_state *state)
+{
+    matching_state_init (state, view);
+
+    for (size_t i = 0; i < result->pairs; i++)
+    {
+        int u = -1, v = -1;
+        for (size_t k = 0; k < view->count; k++)
+        {
+            if (view->members[k] == result->pair_list[i]->a) u = k;
+            if (view->members[k] == result->pair_list[i]->b) v = k;
+        }
+
+        if (u >= 0 && v >= 0)
+        {
+            matching_add (state, u, v, result->pair_list[i]->time);
+        }
+    }
+}
+
+pair_result *
+pairup_augment (relation_graph *today,
+                pair_result *result,
+                struct pairup_stop *stop)
+{
+    matching_view view;
+    matching_state state;
+
+    matching_view_init (&view, today);
+    matching_from_result (&view, result, &state);
+
+    size_t won = matching_augment (&view, &state, stop);
+    if (won == 0)
+    {
+        return result;
+    }
+
+    debug_printf (DEBUG_INFO, "[ INFO    ] Augmenting paths added %zu pairs.\n", won);
+
+    pair_result *improved = matching_to_result (&view, &state);
+    improved->algorithm_applied = result->algorithm_applied;
+    improved->upper_bound = result->upper_bound;
+    free_pair_result (result);
+
+    return improved;
+}
+
+/*****************************  AUGMENTING PATHS (END)  *******************************/
+
+/* Maximum matching first, then the second request of 'twice' members */
+void
+matching_from_match (const matching_view *view,
+                     const int match[],
+                     matching_state *state)
+{
+    matching_state_init (state, view);
+
+    for (size_t u = 0; u < view->count; u++)
+    {
+        int v = match[u];
+        if (v > (int) u)
+        {
+            slot_mask common = view->slots[u] & view->slots[v];
+            matching_add (state, u, v, matching_first_slot (common));
+        }
+    }
+}
+
+size_t
+matching_from_maximum (const matching_view *view,
+                       matching_state *state)
+{
+    int match[MAX_MATCHES_LEN];
+
+    size_t pairs = matching_maximum (view, match);
+    matching_from_match (view, match, state);
+
+    /* Exact as long as nobody asked for two partners */
+    matching_fill_greedy (view, state);
+
+    return pairs;
+}
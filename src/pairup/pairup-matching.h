@@ -0,0 +1,188 @@
+#ifndef PAIRUP_MATCHING_H
+#define PAIRUP_MATCHING_H
+
+#include "pairup-types.h"
+
+/*
+ * A compact, index-based view of a relation graph.
+ *
+ * The greedy priorities walk `relation->candidates[]` directly, which lists
+ * one entry per (partner, slot) combination. The exact engines only need to
+ * know who can meet whom and when, so every member in the graph becomes a
+ * vertex `v` with its slot bitmask and a 64-bit adjacency set.
+ */
+struct matching_view
+{
+    size_t count;                                // Number of vertices
+    member *members[MAX_MATCHES_LEN];            // Vertex -> member
+    int capacity[MAX_MATCHES_LEN];               // Requests of each vertex
+    slot_mask slots[MAX_MATCHES_LEN];            // Available slots of each vertex
+    uint64_t adjacent[MAX_MATCHES_LEN];          // Vertices sharing a slot with `v`
+};
+
+/* A matched edge between vertex `u` and `v` at slot column `time` */
+struct matching_edge
+{
+    int u;
+    int v;
+    slot time;
+};
+
+/* A (partial) b-matching on top of a view, respecting slot exclusivity */
+struct matching_state
+{
+    size_t pairs;                                // Number of matched edges
+    struct matching_edge edges[MAX_MATCHES_LEN]; // Matched edges
+    int remain[MAX_MATCHES_LEN];                 // Remaining requests of each vertex
+    slot_mask used[MAX_MATCHES_LEN];             // Slots already booked by each vertex
+};
+
+typedef struct matching_view matching_view;
+typedef struct matching_state matching_state;
+
+/* Build the view of `today` (vertex order follows `today->relations`) */
+void
+matching_view_init (matching_view *view,
+                    relation_graph *today);
+
+/* Empty matching: every vertex keeps all of its requests */
+void
+matching_state_init (matching_state *state,
+                     const matching_view *view);
+
+/* Slots that `u` and `v` could still use for a new pair, 0 if none */
+slot_mask
+matching_free_slots (const matching_view *view,
+                     const matching_state *state,
+                     int u,
+                     int v);
+
+/* Whether `u` and `v` are already paired in `state` */
+bool
+matching_has_edge (const matching_state *state,
+                   int u,
+                   int v);
+
+/* Add the pair (u, v) at slot column `time`, the caller checks feasibility */
+void
+matching_add (matching_state *state,
+              int u,
+              int v,
+              slot time);
+
+/* Remove the i-th matched edge (the last edge takes its place) */
+void
+matching_remove (matching_state *state,
+                 size_t i);
+
+/* Fill up the remaining requests greedily, in vertex order */
+void
+matching_fill_greedy (const matching_view *view,
+                      matching_state *state);
+
+/* Convert `state` into a freshly allocated pair result */
+pair_result *
+matching_to_result (const matching_view *view,
+                    const matching_state *state);
+
+/* Number of bits set in `x` */
+int
+matching_popcount (uint64_t x);
+
+/* Lowest slot column inside `mask`, -1 if the mask is empty */
+slot
+matching_first_slot (slot_mask mask);
+
+/*
+ * Edmonds' blossom algorithm on the capacity-1 graph.
+ *
+ * `match[v]` holds the vertex matched with `v` or -1. Searching from a free
+ * `root` either augments the matching (returns true) or proves that no
+ * augmenting path starts at `root`. Augmenting never un-matches a vertex.
+ */
+bool
+matching_augment_from (const matching_view *view,
+                       int match[],
+                       int root);
+
+/*
+ * Cover `root` while every vertex in `keep` stays covered: augment if
+ * possible, otherwise swap `root` in for a covered vertex outside `keep`.
+ * Returns false if no matching covers `keep` and `root` together.
+ */
+bool
+matching_cover_from (const matching_view *view,
+                     int match[],
+                     int root,
+                     uint64_t keep);
+
+/* Maximum cardinality matching on the capacity-1 graph */
+size_t
+matching_maximum (const matching_view *view,
+                  int match[]);
+
+/*
+ * Label the connected components of the shared-slot graph with union-find.
+ * Labels run from 0 in order of each component's first vertex, and the
+ * number of components is returned.
+ */
+size_t
+matching_components (const matching_view *view,
+                     int component[]);
+
+/*
+ * Copy the vertices labelled `label` into `sub`, keeping their order.
+ * `vertex[i]` gets the vertex of `view` behind vertex `i` of `sub`.
+ */
+void
+matching_view_subset (const matching_view *view,
+                      const int component[],
+                      int label,
+                      matching_view *sub,
+                      int vertex[]);
+
+/*
+ * Cheap upper bound on the number of pairs: a member takes at most
+ * min(requests, potential partners, available slots) pairs, and each
+ * component can pair up at most half of what its members can take.
+ */
+size_t
+matching_upper_bound (const matching_view *view);
+
+/* Turn a capacity-1 matching `match[]` into a state, every pair at its first common slot */
+void
+matching_from_match (const matching_view *view,
+                     const int match[],
+                     matching_state *state);
+
+/* Maximum matching plus a greedy fill, returns the blossom pair count */
+size_t
+matching_from_maximum (const matching_view *view,
+                       matching_state *state);
+
+/* Rebuild the matching behind a pair result produced on the same graph */
+void
+matching_from_result (const matching_view *view,
+                      const pair_result *result,
+                      matching_state *state);
+
+/*
+ * Apply augmenting paths until none is left.
+ *
+ * A path alternates between new pairs and existing pairs, starts and ends at
+ * members with requests left, and only uses slots that stay free once the
+ * existing pairs on the path are dissolved. Returns the number of pairs won,
+ * checking `stop` (may be NULL) before every path.
+ */
+size_t
+matching_augment (const matching_view *view,
+                  matching_state *state,
+                  struct pairup_stop *stop);
+
+/* Run `matching_augment` on `result`, which is freed if it was improved */
+pair_result *
+pairup_augment (relation_graph *today,
+                pair_result *result,
+                struct pairup_stop *stop);
+
+#endif  // PAIRUP_MATCHING_H
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pairup-multistart.h"
+#include "pairup-algorithm.h"
+#include "pairup-formatter.h"
+#include "pairup-matching.h"
+#include "pairup-pool.h"
+#include "pairup-random.h"
+#include "pairup-types.h"
+
+static const struct pairup_algorithm multistart_algorithm = {
+    "RANDOM_MULTISTART",                          // Best of many random orders.
+    NULL
+};
+
+/* State shared by all workers of one search */
+struct multistart_shared
+{
+    relation_graph *today;
+    member **members;
+    struct pairup_options *x;
+    uint64_t base_seed;
+    size_t max_trials;           // 0: unlimited
+    double start;
+    double deadline;             // 0: no time limit
+    size_t upper_bound;
+    size_t next_trial;           // Next trial number to hand out
+    size_t best_pairs;           // Best pair count published so far
+    int stop;                    // Set once the bound is reached or time is up
+};
+
+/* What one worker has found */
+struct multistart_worker
+{
+    struct multistart_shared *shared;
+    pair_result *best;
+    size_t best_trial;
+    size_t trials;
+};
+
+static pair_result *
+multistart_trial (struct multistart_shared *s,
+                  size_t trial)
+{
+    relation_graph shuffled = *s->today;
+    pairup_random rng;
+    pairup_random_init (&rng, s->base_seed, PAIRUP_STREAM (PAIRUP_STREAM_MULTISTART, trial));
+
+    /* Fisher-Yates on a private copy of the relation order */
+    for (size_t i = shuffled.count; i > 1; i--)
+    {
+        size_t j = pairup_random_below (&rng, i);
+        relation *t = shuffled.relations[i - 1];
+        shuffled.relations[i - 1] = shuffled.relations[j];
+        shuffled.relations[j] = t;
+    }
+
+    pair_result *result = pairup_in_graph_order (&shuffled, s->members);
+    result->algorithm_applied = (struct pairup_algorithm *) &multistart_algorithm;
+
+    if (s->x->augment)
+    {
+        result = pairup_augment (s->today, result, &s->x->stop);
+    }
+
+    return result;
+}
+
+static void
+multistart_worker_run (void *arg)
+{
+    struct multistart_worker *w = (struct multistart_worker *) arg;
+    struct multistart_shared *s = w->shared;
+
+    while (!pairup_atomic_load (&s->stop))
+    {
+        if ((s->deadline > 0 && pairup_clock_ms () >= s->deadline) ||
+            pairup_should_stop (&s->x->stop))
+        {
+            pairup_atomic_store (&s->stop, 1);
+            break;
+        }
+
+        size_t trial = pairup_atomic_fetch_add (&s->next_trial, 1);
+        if (s->max_trials && trial >= s->max_trials)
+        {
+            break;
+        }
+
+        pair_result *result = multistart_trial (s, trial);
+        size_t pairs = result->pairs;
+        w->trials++;
+
+        if (!w->best || pairs > w->best->pairs)
+        {
+            free_pair_result (w->best);
+            w->best = result;
+            w->best_trial = trial;
+        }
+        else
+        {
+            free_pair_result (result);
+        }
+
+        /* Publish (and optionally stream) improvements over every worker */
+        size_t seen = pairup_atomic_load (&s->best_pairs);
+        while (pairs > seen)
+        {
+            if (pairup_atomic_cas (&s->best_pairs, &seen, pairs))
+            {
+                if (s->x->stream)
+                {
+                    fprintf (stderr, "[ STREAM  ] %.1f ms: trial %zu found %zu pairs\n",
+                             pairup_clock_ms () - s->start, trial, pairs);
+                }
+                break;
+            }
+        }
+
+        /* Trials below this one were handed out already and will finish */
+        if (pairs >= s->upper_bound)
+        {
+            pairup_atomic_store (&s->stop, 1);
+        }
+    }
+}
+
+pair_result *
+pairup_multistart (relation_graph *today,
+                   member *members[],
+                   struct pairup_options *x,
+                   uint64_t base_seed,
+                   size_t upper_bound,
+                   pair_result *incumbent)
+{
+    if (incumbent && incumbent->pairs >= upper_bound)
+    {
+        return incumbent;
+    }
+
+    struct multistart_shared shared;
+    shared.today = today;
+    shared.members = members;
+    shared.x = x;
+    shared.base_seed = base_seed;
+    shared.max_trials = x->seeds;
+    shared.start = pairup_clock_ms ();
+    shared.deadline = (x->time_budget_ms > 0) ? shared.start + x->time_budget_ms : 0;
+    shared.upper_bound = upper_bound;
+    shared.next_trial = 0;
+    shared.best_pairs = incumbent ? incumbent->pairs : 0;
+    shared.stop = 0;
+
+    int jobs = (x->jobs > 0) ? x->jobs : pairup_pool_default_threads ();
+    struct multistart_worker *workers = (struct multistart_worker *) calloc (jobs, sizeof(struct multistart_worker));
+    if (!workers)
+    {
+        return incumbent;
+    }
+
+    pairup_pool *pool = (jobs > 1) ? pairup_pool_new (jobs) : NULL;
+    for (int i = 0; i < jobs; i++)
+    {
+        workers[i].shared = &shared;
+        if (!pool || !pairup_pool_submit (pool, multistart_worker_run, &workers[i]))
+        {
+            multistart_worker_run (&workers[i]);
+        }
+    }
+    if (pool)
+    {
+        pairup_pool_wait (pool);
+        pairup_pool_free (pool);
+    }
+
+    /* Most pairs first, then the lowest trial number */
+    struct multistart_worker *winner = NULL;
+    size_t trials = 0;
+    for (int i = 0; i < jobs; i++)
+    {
+        struct multistart_worker *w = &workers[i];
+        trials += w->trials;
+        if (!w->best)
+        {
+            continue;
+        }
+
+        if (!winner || w->best->pairs > winner->best->pairs ||
+            (w->best->pairs == winner->best->pairs && w->best_trial < winner->best_trial))
+        {
+            winner = w;
+        }
+    }
+
+    debug_printf (DEBUG_SUMMARY, "\
+[ SUMMARY ] Multi-start: %zu trials in %.1f ms, best trial %zu with %zu pairs\n",
+trials, pairup_clock_ms () - shared.start,
+winner ? winner->best_trial : 0, winner ? winner->best->pairs : 0);
+
+    pair_result *best = incumbent;
+    if (winner && (!incumbent || winner->best->pairs > incumbent->pairs))
+    {
+        free_pair_result (incumbent);
+        best = winner->best;
+        winner->best = NULL;
+    }
+
+    for (int i = 0; i < jobs; i++)
+    {
+        free_pair_result (workers[i].best);
+    }
+    free (workers);
+
+    return best;
+}
@@ -0,0 +1,27 @@
+#ifndef PAIRUP_MULTISTART_H
+#define PAIRUP_MULTISTART_H
+
+#include "pairup-types.h"
+
+/*
+ * Anytime randomized multi-start search.
+ *
+ * Every trial pairs up the members in a random order (followed by the
+ * augmenting-path pass when enabled). Trials run on `x->jobs` threads until
+ * `x->seeds` trials are done, `x->time_budget_ms` has passed or a trial
+ * reaches `upper_bound`, whichever comes first.
+ *
+ * Trial `i` is fully determined by `base_seed` and `i`, and ties are broken
+ * by the lowest trial number, so a fixed number of trials always gives the
+ * same answer. Returns the better of `incumbent` and the best trial; the
+ * other one is freed.
+ */
+pair_result *
+pairup_multistart (relation_graph *today,
+                   member *members[],
+                   struct pairup_options *x,
+                   uint64_t base_seed,
+                   size_t upper_bound,
+                   pair_result *incumbent);
+
+#endif  // PAIRUP_MULTISTART_H
@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pairup-pool.h"
+#include "pairup-formatter.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+
+/* No pthreads: every task runs inline on the caller's thread */
+struct pairup_pool
+{
+    int threads;
+};
+
+int
+pairup_pool_default_threads (void)
+{
+    return 1;
+}
+
+pairup_pool *
+pairup_pool_new (int threads)
+{
+    pairup_pool *pool = (pairup_pool *) malloc (sizeof(pairup_pool));
+    if (pool)
+    {
+        pool->threads = 1;
+    }
+    return pool;
+}
+
+int
+pairup_pool_threads (pairup_pool *pool)
+{
+    return pool->threads;
+}
+
+bool
+pairup_pool_in_worker (void)
+{
+    return false;
+}
+
+bool
+pairup_pool_submit (pairup_pool *pool,
+                    pairup_task fn,
+                    void *arg)
+{
+    fn (arg);
+    return true;
+}
+
+bool
+pairup_pool_submit_group (pairup_pool *pool,
+                          pairup_group *group,
+                          pairup_task fn,
+                          void *arg)
+{
+    fn (arg);
+    return true;
+}
+
+void
+pairup_pool_wait (pairup_pool *pool)
+{
+}
+
+void
+pairup_pool_wait_group (pairup_pool *pool,
+                        pairup_group *group)
+{
+}
+
+void
+pairup_pool_free (pairup_pool *pool)
+{
+    free (pool);
+}
+
+#else
+
+#include <pthread.h>
+#include <unistd.h>
+
+struct pool_task
+{
+    pairup_task fn;
+    void *arg;
+    const struct pairup_log *log;  // Log of the submitting thread
+    pairup_group *group;           // NULL: not in a group
+    struct pool_task *next;
+};
+
+struct pairup_pool
+{
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;        // Signalled when a task is queued or on shutdown
+    pthread_cond_t  idle;        // Signalled when the last pending task (of a group) finishes
+    pthread_t *workers;
+    int threads;
+    struct pool_task *head;
+    struct pool_task *tail;
+    size_t pending;              // Queued plus running tasks
+    bool stopping;
+};
+
+static __thread bool running_in_worker = false;
+
+static void *
+pool_worker (void *arg)
+{
+    pairup_pool *pool = (pairup_pool *) arg;
+
+    running_in_worker = true;
+
+    pthread_mutex_lock (&pool->lock);
+    for (;;)
+    {
+        while (!pool->head && !pool->stopping)
+        {
+            pthread_cond_wait (&pool->wake, &pool->lock);
+        }
+
+        if (!pool->head)
+        {
+            break;
+        }
+
+        struct pool_task *task = pool->head;
+        pool->head = task->next;
+        if (!pool->head)
+        {
+            pool->tail = NULL;
+        }
+
+        pthread_mutex_unlock (&pool->lock);
+        pairup_log_swap (task->log);
+        task->fn (task->arg);
+        pairup_log_swap (NULL);
+        pthread_mutex_lock (&pool->lock);
+
+        bool group_done = task->group && --task->group->pending == 0;
+        if (--pool->pending == 0 || group_done)
+        {
+            pthread_cond_broadcast (&pool->idle);
+        }
+        free (task);
+    }
+    pthread_mutex_unlock (&pool->lock);
+
+    return NULL;
+}
+
+int
+pairup_pool_default_threads (void)
+{
+    long n = sysconf (_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int) n : 1;
+}
+
+pairup_pool *
+pairup_pool_new (int threads)
+{
+    pairup_pool *pool = (pairup_pool *) calloc (1, sizeof(pairup_pool));
+    if (!pool)
+    {
+        fprintf (stderr, "Memory allocation failed for pairup_pool\n");
+        return NULL;
+    }
+
+    if (threads <= 0)
+    {
+        threads = pairup_pool_default_threads ();
+    }
+
+    pool->workers = (pthread_t *) malloc (threads * sizeof(pthread_t));
+    if (!pool->workers)
+    {
+        free (pool);
+        return NULL;
+    }
+
+    pthread_mutex_init (&pool->lock, NULL);
+    pthread_cond_init (&pool->wake, NULL);
+    pthread_cond_init (&pool->idle, NULL);
+
+    for (int i = 0; i < threads; i++)
+    {
+        if (pthread_create (&pool->workers[i], NULL, pool_worker, pool) != 0)
+        {
+            break;
+        }
+        pool->threads++;
+    }
+
+    if (pool->threads == 0)
+    {
+        pairup_pool_free (pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+int
+pairup_pool_threads (pairup_pool *pool)
+{
+    return pool->threads;
+}
+
+bool
+pairup_pool_in_worker (void)
+{
+    return running_in_worker;
+}
+
+bool
+pairup_pool_submit_group (pairup_pool *pool,
+                          pairup_group *group,
+                          pairup_task fn,
+                          void *arg)
+{
+    struct pool_task *task = (struct pool_task *) malloc (sizeof(struct pool_task));
+    if (!task)
+    {
+        return false;
+    }
+
+    task->fn = fn;
+    task->arg = arg;
+    task->log = pairup_log_current ();
+    task->group = group;
+    task->next = NULL;
+
+    pthread_mutex_lock (&pool->lock);
+    if (pool->tail)
+    {
+        pool->tail->next = task;
+    }
+    else
+    {
+        pool->head = task;
+    }
+    pool->tail = task;
+    pool->pending++;
+    if (group)
+    {
+        group->pending++;
+    }
+    pthread_cond_signal (&pool->wake);
+    pthread_mutex_unlock (&pool->lock);
+
+    return true;
+}
+
+bool
+pairup_pool_submit (pairup_pool *pool,
+                    pairup_task fn,
+                    void *arg)
+{
+    return pairup_pool_submit_group (pool, NULL, fn, arg);
+}
+
+void
+pairup_pool_wait (pairup_pool *pool)
+{
+    pthread_mutex_lock (&pool->lock);
+    while (pool->pending > 0)
+    {
+        pthread_cond_wait (&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock (&pool->lock);
+}
+
+void
+pairup_pool_free (pairup_pool *pool)
+{
+    if (!pool)
+    {
+        return;
+    }
+
+    pthread_mutex_lock (&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast (&pool->wake);
+    pthread_mutex_unlock (&pool->lock);
+
+    for (int i = 0; i < pool->threads; i++)
+    {
+        pthread_join (pool->workers[i], NULL);
+    }
+
+    pthread_mutex_destroy (&pool->lock);
+    pthread_cond_destroy (&pool->wake);
+    pthread_cond_destroy (&pool->idle);
+    free (pool->workers);
+    free (pool);
+}
+
+void
+pairup_pool_wait_group (pairup_pool *pool,
+                        pairup_group *group)
+{
+    pthread_mutex_lock (&pool->lock);
+    while (group->pending > 0)
+    {
+        pthread_cond_wait (&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock (&pool->lock);
+}
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef PAIRUP_POOL_H
+#define PAIRUP_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A fixed-size worker pool.
+ *
+ * Tasks run in submission order on whichever worker is free, with the log
+ * of the thread that submitted them, and `pairup_pool_wait` blocks until
+ * every submitted task has finished.
+ * Platforms without pthreads run each task inline in `pairup_pool_submit`.
+ */
+typedef struct pairup_pool pairup_pool;
+
+typedef void (*pairup_task) (void *arg);
+
+/* Tasks that can be waited for apart from the rest of the pool */
+typedef struct pairup_group
+{
+    size_t pending;              // Queued plus running tasks of the group
+} pairup_group;
+
+#define PAIRUP_GROUP_INIT  { 0 }
+
+/* Flags shared between tasks (plain access where tasks run inline) */
+#if defined(__GNUC__)
+#define pairup_atomic_load(p)          __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+#define pairup_atomic_store(p, v)      __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+#define pairup_atomic_fetch_add(p, v)  __atomic_fetch_add ((p), (v), __ATOMIC_ACQ_REL)
+#define pairup_atomic_cas(p, e, v)     __atomic_compare_exchange_n ((p), (e), (v), false, \
+                                                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#else
+#define pairup_atomic_load(p)          (*(p))
+#define pairup_atomic_store(p, v)      (*(p) = (v))
+#define pairup_atomic_fetch_add(p, v)  ((*(p) += (v)) - (v))
+#define pairup_atomic_cas(p, e, v)     ((*(p) == *(e)) ? (*(p) = (v), true) : (*(e) = *(p), false))
+#endif
+
+/* Number of online processors, at least 1 */
+int
+pairup_pool_default_threads (void);
+
+/* `threads` <= 0 means one worker per online processor */
+pairup_pool *
+pairup_pool_new (int threads);
+
+int
+pairup_pool_threads (pairup_pool *pool);
+
+/* Whether the caller runs on a pool worker (nested pools just oversubscribe) */
+bool
+pairup_pool_in_worker (void);
+
+bool
+pairup_pool_submit (pairup_pool *pool,
+                    pairup_task fn,
+                    void *arg);
+
+/* Same as `pairup_pool_submit`, counting the task in `group` */
+bool
+pairup_pool_submit_group (pairup_pool *pool,
+                          pairup_group *group,
+                          pairup_task fn,
+                          void *arg);
+
+void
+pairup_pool_wait (pairup_pool *pool);
+
+/* Block until every task of `group` has finished, whatever else is queued */
+void
+pairup_pool_wait_group (pairup_pool *pool,
+                        pairup_group *group);
+
+void
+pairup_pool_free (pairup_pool *pool);
+
+#endif  // PAIRUP_POOL_H
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "pairup-priority.h"
+#include "pairup-formatter.h"
+#include "pairup-types.h"
+
+#define PRIORITY_TERM_MAX   ((1u << PRIORITY_TERM_BITS) - 1)
+#define PRIORITY_RADIX_BITS 8
+
+static const char *const field_names[] = {
+    [PRIORITY_AVAILABILITY] = "availability",
+    [PRIORITY_REQUESTS]     = "requests",
+    [PRIORITY_EARLIEST]     = "earliest",
+    [PRIORITY_PARTNERS]     = "partners",
+    [PRIORITY_ROW]          = "row",
+};
+
+/* Copy the next `sep`-separated token of `*text` into `out` without blanks */
+static size_t
+priority_token (const char **text,
+                char sep,
+                char *out,
+                size_t out_size)
+{
+    const char *p = *text;
+    size_t n = 0;
+
+    while (*p && *p != sep && *p != ',')
+    {
+        if (!isspace ((unsigned char) *p) && n + 1 < out_size)
+        {
+            out[n++] = tolower ((unsigned char) *p);
+        }
+        p++;
+    }
+
+    out[n] = '\0';
+    *text = p;
+    return n;
+}
+
+bool
+priority_compile (const char *text,
+                  struct priority_expr *expr)
+{
+    const char *p = text;
+
+    expr->terms = 0;
+    for (;;)
+    {
+        char name[32], order[8] = "asc";
+
+        priority_token (&p, ':', name, sizeof(name));
+        if (*p == ':')
+        {
+            p++;
+            priority_token (&p, ',', order, sizeof(order));
+        }
+
+        int field = -1;
+        for (size_t i = 0; i < sizeof(field_names) / sizeof(field_names[0]); i++)
+        {
+            if (strcmp (name, field_names[i]) == 0)
+            {
+                field = i;
+            }
+        }
+
+        if (field < 0)
+        {
+            debug_printf (DEBUG_WARNING, "\
+[ WARNING ] Unknown priority key '%s' (availability, requests, earliest, partners or row).\n", name);
+            return false;
+        }
+        if (strcmp (order, "asc") != 0 && strcmp (order, "desc") != 0)
+        {
+            debug_printf (DEBUG_WARNING, "[ WARNING ] Unknown priority order '%s' (asc or desc).\n", order);
+            return false;
+        }
+        if (expr->terms == PRIORITY_MAX_TERMS)
+        {
+            debug_printf (DEBUG_WARNING, "[ WARNING ] A priority has at most %d keys.\n", PRIORITY_MAX_TERMS);
+            return false;
+        }
+
+        expr->field[expr->terms] = field;
+        expr->descending[expr->terms] = (strcmp (order, "desc") == 0);
+        expr->terms++;
+
+        if (*p != ',')
+        {
+            return true;
+        }
+        p++;
+    }
+}
+
+static unsigned
+priority_value (enum priority_field field,
+                const relation *r)
+{
+    const member *m = r->candidates[0];
+    size_t value = 0;
+
+    switch (field)
+    {
+        case PRIORITY_AVAILABILITY: value = m->availability; break;
+        case PRIORITY_REQUESTS:     value = m->requests; break;
+        case PRIORITY_EARLIEST:     value = (m->earliest_slot > 0) ? m->earliest_slot : 0; break;
+        case PRIORITY_PARTNERS:     value = r->count; break;
+        case PRIORITY_ROW:          value = (m->id > 0) ? m->id : 0; break;
+    }
+
+    return (value > PRIORITY_TERM_MAX) ? PRIORITY_TERM_MAX : (unsigned) value;
+}
+
+uint64_t
+priority_key (const struct priority_expr *expr,
+              const relation *r)
+{
+    uint64_t key = 0;
+
+    for (size_t i = 0; i < expr->terms; i++)
+    {
+        unsigned value = priority_value (expr->field[i], r);
+        if (expr->descending[i])
+        {
+            value = PRIORITY_TERM_MAX - value;
+        }
+        key = (key << PRIORITY_TERM_BITS) | value;
+    }
+
+    return key;
+}
+
+struct keyed_relation
+{
+    uint64_t key;
+    relation *relation;
+};
+
+void
+priority_sort (const struct priority_expr *expr,
+               relation_graph *today)
+{
+    struct keyed_relation buffer[2][MAX_MATCHES_LEN];
+    struct keyed_relation *from = buffer[0], *to = buffer[1];
+    size_t n = today->count;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        from[i].key = priority_key (expr, today->relations[i]);
+        from[i].relation = today->relations[i];
+    }
+
+    /* Least significant digit first, every pass keeps the order of equal digits */
+    size_t passes = expr->terms * PRIORITY_TERM_BITS / PRIORITY_RADIX_BITS;
+    for (size_t pass = 0; pass < passes; pass++)
+    {
+        size_t count[(1 << PRIORITY_RADIX_BITS) + 1] = { 0 };
+        int shift = pass * PRIORITY_RADIX_BITS;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            count[((from[i].key >> shift) & ((1 << PRIORITY_RADIX_BITS) - 1)) + 1]++;
+        }
+        for (size_t d = 1; d <= (1 << PRIORITY_RADIX_BITS); d++)
+        {
+            count[d] += count[d - 1];
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            to[count[(from[i].key >> shift) & ((1 << PRIORITY_RADIX_BITS) - 1)]++] = from[i];
+        }
+
+        struct keyed_relation *t = from;
+        from = to;
+        to = t;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        today->relations[i] = from[i].relation;
+    }
+}
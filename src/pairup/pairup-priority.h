@@ -0,0 +1,50 @@
+#ifndef PAIRUP_PRIORITY_H
+#define PAIRUP_PRIORITY_H
+
+#include <stdbool.h>
+
+#include "pairup-types.h"
+
+/*
+ * Priority expressions, e.g. "availability:asc,requests:desc,earliest".
+ *
+ * Every term names a member property and a direction (ascending by default),
+ * and later terms break the ties of earlier ones. An expression is compiled
+ * into one packed 64-bit key per member, 16 bits per term with the first
+ * term on top, so sorting never looks at the members again.
+ */
+#define PRIORITY_MAX_TERMS  4
+#define PRIORITY_TERM_BITS  16
+
+enum priority_field
+{
+    PRIORITY_AVAILABILITY,       // "availability": slots filled in
+    PRIORITY_REQUESTS,           // "requests": practices requested
+    PRIORITY_EARLIEST,           // "earliest": earliest available slot
+    PRIORITY_PARTNERS,           // "partners": (partner, slot) candidates
+    PRIORITY_ROW                 // "row": row on the sheet
+};
+
+struct priority_expr
+{
+    size_t terms;
+    enum priority_field field[PRIORITY_MAX_TERMS];
+    bool descending[PRIORITY_MAX_TERMS];
+};
+
+/* Parse `text` into `expr`, returns false (with a warning) if it is not valid */
+bool
+priority_compile (const char *text,
+                  struct priority_expr *expr);
+
+/* Packed sort key of `r`, smaller keys are paired up first */
+uint64_t
+priority_key (const struct priority_expr *expr,
+              const relation *r);
+
+/* Stable radix sort of `today->relations` by their keys */
+void
+priority_sort (const struct priority_expr *expr,
+               relation_graph *today);
+
+#endif  // PAIRUP_PRIORITY_H
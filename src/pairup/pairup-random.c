@@ -0,0 +1,53 @@
+#include "pairup-random.h"
+#include "pairup-pool.h"
+
+#define SPLITMIX_GAMMA 0x9E3779B97F4A7C15ULL
+
+static uint64_t
+splitmix_mix (uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void
+pairup_random_init (pairup_random *r,
+                    uint64_t seed,
+                    uint64_t stream)
+{
+    r->counter = splitmix_mix (seed + SPLITMIX_GAMMA * (splitmix_mix (stream) | 1));
+}
+
+uint64_t
+pairup_random_next (pairup_random *r)
+{
+    return splitmix_mix (r->counter += SPLITMIX_GAMMA);
+}
+
+uint64_t
+pairup_random_next_shared (pairup_random *r)
+{
+    return splitmix_mix (pairup_atomic_fetch_add (&r->counter, SPLITMIX_GAMMA) + SPLITMIX_GAMMA);
+}
+
+uint64_t
+pairup_random_below (pairup_random *r,
+                     uint64_t bound)
+{
+    uint64_t threshold = (0 - bound) % bound;
+    for (;;)
+    {
+        uint64_t x = pairup_random_next (r);
+        if (x >= threshold)
+        {
+            return x % bound;
+        }
+    }
+}
+
+double
+pairup_random_unit (pairup_random *r)
+{
+    return (pairup_random_next (r) >> 11) * 0x1.0p-53;
+}
@@ -0,0 +1,52 @@
+#ifndef PAIRUP_RANDOM_H
+#define PAIRUP_RANDOM_H
+
+#include <stdint.h>
+
+/*
+ * Counter-based random numbers (SplitMix64).
+ *
+ * A generator is fully determined by a seed and a stream number, so every
+ * trial, task or tie-break can own an independent stream without sharing
+ * any state: the same seed always reproduces the same run, on any number
+ * of threads.
+ */
+typedef struct pairup_random pairup_random;
+
+struct pairup_random
+{
+    uint64_t counter;
+};
+
+/* Stream numbers, `PAIRUP_STREAM (domain, index)` */
+enum
+{
+    PAIRUP_STREAM_TIE_BREAK,     // Ties between priorities of the sweep
+    PAIRUP_STREAM_LOCAL,         // Moves of the local search
+    PAIRUP_STREAM_MULTISTART     // Member orders, per multi-start trial
+};
+
+#define PAIRUP_STREAM(domain, index)  (((uint64_t) (domain) << 48) ^ (uint64_t) (index))
+
+void
+pairup_random_init (pairup_random *r,
+                    uint64_t seed,
+                    uint64_t stream);
+
+uint64_t
+pairup_random_next (pairup_random *r);
+
+/* Same as `pairup_random_next`, for a generator several threads draw from */
+uint64_t
+pairup_random_next_shared (pairup_random *r);
+
+/* Uniform integer in [0, bound), without modulo bias */
+uint64_t
+pairup_random_below (pairup_random *r,
+                     uint64_t bound);
+
+/* Uniform double in [0, 1) */
+double
+pairup_random_unit (pairup_random *r);
+
+#endif  // PAIRUP_RANDOM_H
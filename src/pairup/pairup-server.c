@@ -0,0 +1,1463 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "pairup-server.h"
+#include "pairup-algorithm.h"
+#include "pairup-cache.h"
+#include "pairup-formatter.h"
+#include "pairup-pool.h"
+#include "pairup-types.h"
+#include "rw-csv.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#define service_lock(s)    pthread_mutex_lock (&(s)->lock)
+#define service_unlock(s)  pthread_mutex_unlock (&(s)->lock)
+#else
+#define service_lock(s)    ((void) 0)
+#define service_unlock(s)  ((void) 0)
+#endif
+
+/* Replies kept in memory, the least recently used one is replaced */
+#define SERVICE_CACHE_ENTRIES  256
+
+/* Longest option token and largest message a client may send */
+#define SERVICE_TOKEN_LEN      1024
+#define SERVE_MAX_MESSAGE      (16 * 1024 * 1024)
+
+struct service_entry
+{
+    uint64_t key;
+    char *reply;                 // NULL: unused
+    uint64_t used;               // Stamp of the last lookup
+};
+
+struct pairup_service
+{
+    struct pairup_options defaults;
+    const char *salt;
+#if !defined(_WIN32) && !defined(_WIN64)
+    pthread_mutex_t lock;        // Guards `entries`, `clock` and the solve counters
+#endif
+    struct service_entry entries[SERVICE_CACHE_ENTRIES];
+    uint64_t clock;
+    size_t requests;             // Atomic
+    size_t errors;               // Atomic
+    size_t hits;
+    size_t solved;
+    double solve_ms;
+};
+
+pairup_service *
+pairup_service_new (const struct pairup_options *defaults,
+                    const char *salt)
+{
+    pairup_service *service = (pairup_service *) calloc (1, sizeof(pairup_service));
+    if (!service)
+    {
+        fprintf (stderr, "Memory allocation failed for pairup_service\n");
+        return NULL;
+    }
+
+    service->defaults = *defaults;
+    service->salt = salt ? salt : "";
+
+    /* Replies are JSON, keyed (and so seeded) like `pairup -j` */
+    service->defaults.json_output = true;
+
+    /* Requests run side by side, so each one is solved on a single thread */
+    service->defaults.jobs = 1;
+    service->defaults.time_budget_ms = 0;
+    service->defaults.stream = false;
+    service->defaults.ensure = false;
+    service->defaults.ensure_member_list = NULL;
+
+#if !defined(_WIN32) && !defined(_WIN64)
+    pthread_mutex_init (&service->lock, NULL);
+#endif
+    return service;
+}
+
+void
+pairup_service_free (pairup_service *service)
+{
+    if (!service)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < SERVICE_CACHE_ENTRIES; i++)
+    {
+        free (service->entries[i].reply);
+    }
+#if !defined(_WIN32) && !defined(_WIN64)
+    pthread_mutex_destroy (&service->lock);
+#endif
+    free (service);
+}
+
+/* A copy of the reply cached under `key`, NULL on a miss */
+static char *
+service_lookup (pairup_service *service,
+                uint64_t key)
+{
+    char *reply = NULL;
+
+    service_lock (service);
+    for (size_t i = 0; i < SERVICE_CACHE_ENTRIES; i++)
+    {
+        struct service_entry *e = &service->entries[i];
+        if (e->reply && e->key == key)
+        {
+            e->used = ++service->clock;
+            reply = strdup (e->reply);
+            service->hits++;
+            break;
+        }
+    }
+    service_unlock (service);
+
+    return reply;
+}
+
+static void
+service_store (pairup_service *service,
+               uint64_t key,
+               const char *reply)
+{
+    char *copy = strdup (reply);
+    if (!copy)
+    {
+        return;
+    }
+
+    service_lock (service);
+    struct service_entry *victim = &service->entries[0];
+    for (size_t i = 0; i < SERVICE_CACHE_ENTRIES; i++)
+    {
+        struct service_entry *e = &service->entries[i];
+        if (e->reply && e->key == key)
+        {
+            victim = e;
+            break;
+        }
+        if (!e->reply || e->used < victim->used)
+        {
+            victim = e;
+        }
+    }
+
+    free (victim->reply);
+    victim->key = key;
+    victim->reply = copy;
+    victim->used = ++service->clock;
+    service_unlock (service);
+}
+
+static char *
+service_error (const char *message)
+{
+    return new_error_json_string (message);
+}
+
+/* Next whitespace separated token, quotes group words: `-e 'Mary Ann'` */
+static bool
+service_next_token (const char **cursor,
+                    const char *end,
+                    char *out,
+                    size_t out_size)
+{
+    const char *p = *cursor;
+    size_t n = 0;
+    char quote = '\0';
+
+    while (p < end && isspace ((unsigned char) *p))
+    {
+        p++;
+    }
+    if (p >= end)
+    {
+        *cursor = p;
+        return false;
+    }
+
+    for (; p < end && (quote || !isspace ((unsigned char) *p)); p++)
+    {
+        if (quote && *p == quote)
+        {
+            quote = '\0';
+        }
+        else if (!quote && (*p == '\'' || *p == '"'))
+        {
+            quote = *p;
+        }
+        else if (n + 1 < out_size)
+        {
+            out[n++] = *p;
+        }
+    }
+    out[n] = '\0';
+
+    *cursor = p;
+    return true;
+}
+
+/* Apply one option of the request line, false if a flag is given a value */
+static bool
+service_apply_option (const char *name,
+                      const char *value,
+                      struct pairup_options *x,
+                      udel *elist)
+{
+    if (strcmp (name, "json-output") == 0)
+    {
+        return value == NULL;
+    }
+    if (strcmp (name, "no-augment") == 0)
+    {
+        x->augment = false;
+        return value == NULL;
+    }
+    if (strcmp (name, "no-cache") == 0)
+    {
+        x->cache = false;
+        return value == NULL;
+    }
+
+    if (value == NULL)
+    {
+        return false;
+    }
+
+    if (strcmp (name, "priority") == 0)
+    {
+        x->priority = true;
+        strncpy (x->priority_func, value, sizeof(x->priority_func) - 1);
+        x->priority_func[sizeof(x->priority_func) - 1] = '\0';
+    }
+    else if (strcmp (name, "ensure") == 0)
+    {
+        if (elist->ensure_list_size < MAX_MEMBERS_LEN)
+        {
+            strncpy (elist->ensure_list_content[elist->ensure_list_size], value, MAX_NAME_LEN - 1);
+            elist->ensure_list_size++;
+        }
+        x->ensure = true;
+        x->ensure_member_list = elist;
+    }
+    else if (strcmp (name, "seed") == 0)
+    {
+        x->seed = strtoull (value, NULL, 10);
+        x->seeded = true;
+    }
+    else if (strcmp (name, "exact-nodes") == 0)
+    {
+        x->exact_node_limit = strtoul (value, NULL, 10);
+        x->exact_budget_given = true;
+    }
+    else if (strcmp (name, "exact-ms") == 0)
+    {
+        x->exact_time_limit_ms = atoi (value);
+        x->exact_budget_given = true;
+    }
+    else if (strcmp (name, "local-iters") == 0)
+    {
+        x->local_iterations = strtoul (value, NULL, 10);
+        x->local_budget_given = true;
+    }
+    else if (strcmp (name, "local-ms") == 0)
+    {
+        x->local_time_limit_ms = atoi (value);
+        x->local_budget_given = true;
+    }
+    else if (strcmp (name, "seeds") == 0)
+    {
+        x->seeds = strtoul (value, NULL, 10);
+    }
+    else if (strcmp (name, "deadline-ms") == 0)
+    {
+        x->deadline_ms = atoi (value);
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/* 1: `name` is followed by a value, 0: it is a flag, -1: unknown option */
+static int
+service_option_arity (const char *name)
+{
+    static const char *const flags[] = { "json-output", "no-augment", "no-cache", NULL };
+    static const char *const valued[] = {
+        "priority", "ensure", "seed", "exact-nodes", "exact-ms",
+        "local-iters", "local-ms", "seeds", "deadline-ms", NULL
+    };
+
+    for (int i = 0; flags[i]; i++)
+    {
+        if (strcmp (name, flags[i]) == 0)
+        {
+            return 0;
+        }
+    }
+    for (int i = 0; valued[i]; i++)
+    {
+        if (strcmp (name, valued[i]) == 0)
+        {
+            return 1;
+        }
+    }
+    return -1;
+}
+
+static bool
+service_parse_options (const char *line,
+                       size_t size,
+                       struct pairup_options *x,
+                       udel *elist,
+                       char *error,
+                       size_t error_size)
+{
+    const char *cursor = line, *end = line + size;
+    char token[SERVICE_TOKEN_LEN], value[SERVICE_TOKEN_LEN];
+
+    while (service_next_token (&cursor, end, token, sizeof(token)))
+    {
+        char name[SERVICE_TOKEN_LEN];
+        const char *inline_value = NULL;
+
+        if (token[0] == '-' && token[1] == '-')
+        {
+            char *eq = strchr (token + 2, '=');
+            if (eq)
+            {
+                *eq = '\0';
+                inline_value = eq + 1;
+            }
+            snprintf (name, sizeof(name), "%s", token + 2);
+        }
+        else if (token[0] == '-' && token[1] && strchr ("pej", token[1]))
+        {
+            snprintf (name, sizeof(name), "%s",
+                      token[1] == 'p' ? "priority" : token[1] == 'e' ? "ensure" : "json-output");
+            inline_value = token[2] ? token + 2 : NULL;
+        }
+        else
+        {
+            snprintf (error, error_size, "Unknown request option '%s'", token);
+            return false;
+        }
+
+        int arity = service_option_arity (name);
+        if (arity < 0)
+        {
+            snprintf (error, error_size, "Unknown request option '%s'", name);
+            return false;
+        }
+
+        if (!inline_value && arity > 0)
+        {
+            if (!service_next_token (&cursor, end, value, sizeof(value)))
+            {
+                snprintf (error, error_size, "Option '%s' requires a value", name);
+                return false;
+            }
+            inline_value = value;
+        }
+
+        if (!service_apply_option (name, inline_value, x, elist))
+        {
+            snprintf (error, error_size, "Option '%s' does not take a value", name);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Solve `csv` with the options of one request, `ok` tells a result from an error */
+static char *
+service_reply (pairup_service *service,
+               struct pairup_options *x,
+               const char *csv,
+               size_t size,
+               bool *ok)
+{
+    char error[256];
+    char *reply = NULL;
+
+    *ok = false;
+    sheet *worksheet = (sheet *) calloc (1, sizeof(sheet));
+    if (!worksheet)
+    {
+        return service_error ("Out of memory");
+    }
+
+    *worksheet = read_csv_buffer (csv, size, "request");
+    if (!pairup_check_sheet (worksheet, error, sizeof(error)))
+    {
+        reply = service_error (error);
+        goto done;
+    }
+
+    uint64_t key = pairup_cache_key (worksheet, x, service->salt);
+    if (x->cache && (reply = service_lookup (service, key)) != NULL)
+    {
+        *ok = true;
+        goto done;
+    }
+
+    if (!x->seeded)
+    {
+        x->seed = key;
+    }
+    shuffle_worksheet (worksheet, x->seed);
+
+    double start = pairup_clock_ms ();
+    pair_result *result = __pairup__ (worksheet, x);
+    bool partial = result->partial || result->unsettled;
+    reply = new_result_json_string (worksheet, result);
+    free_pair_result (result);
+
+    service_lock (service);
+    service->solved++;
+    service->solve_ms += pairup_clock_ms () - start;
+    service_unlock (service);
+
+    /*
+     * A reply cut short by its deadline, or by a search budget short of the
+     * bound, is not the answer to the request: the next one may do better
+     */
+    if (x->cache && reply && !partial)
+    {
+        service_store (service, key, reply);
+    }
+    *ok = (reply != NULL);
+
+done:
+    if (worksheet->data)
+    {
+        free_sheet (&worksheet);
+    }
+    else
+    {
+        free (worksheet->path);
+        free (worksheet);
+    }
+
+    return reply ? reply : service_error ("Out of memory");
+}
+
+static char *
+service_finish (pairup_service *service,
+                char *reply,
+                bool ok)
+{
+    if (!ok)
+    {
+        pairup_atomic_fetch_add (&service->errors, 1);
+    }
+    return reply;
+}
+
+char *
+pairup_service_pair (pairup_service *service,
+                     const char *request,
+                     size_t size)
+{
+    const char *newline = (const char *) memchr (request, '\n', size);
+    size_t line_size = newline ? (size_t) (newline - request) : size;
+    const char *csv = newline ? newline + 1 : request + size;
+    struct pairup_options x = service->defaults;
+    bool ok = false;
+    char error[SERVICE_TOKEN_LEN + 64];
+    char *reply;
+
+    pairup_atomic_fetch_add (&service->requests, 1);
+
+    udel *elist = (udel *) calloc (1, sizeof(udel));
+    if (!elist)
+    {
+        return service_finish (service, service_error ("Out of memory"), false);
+    }
+
+    if (service_parse_options (request, line_size, &x, elist, error, sizeof(error)))
+    {
+        reply = service_reply (service, &x, csv, size - (csv - request), &ok);
+    }
+    else
+    {
+        reply = service_error (error);
+    }
+
+    free (elist);
+    return service_finish (service, reply, ok);
+}
+
+void
+pairup_service_stats (pairup_service *service,
+                      struct pairup_service_stats *stats)
+{
+    service_lock (service);
+    stats->requests = pairup_atomic_load (&service->requests);
+    stats->errors = pairup_atomic_load (&service->errors);
+    stats->hits = service->hits;
+    stats->solved = service->solved;
+    stats->solve_ms = service->solve_ms;
+    stats->cached = 0;
+    for (size_t i = 0; i < SERVICE_CACHE_ENTRIES; i++)
+    {
+        stats->cached += (service->entries[i].reply != NULL);
+    }
+    service_unlock (service);
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+int
+pairup_serve_unix (const char *path,
+                   const struct pairup_options *x,
+                   const char *salt)
+{
+    debug_printf (DEBUG_ERROR, "[ ERROR   ] --serve needs Unix domain sockets, which this platform lacks.\n");
+    return EXIT_FAILURE;
+}
+
+int
+pairup_serve_http (const char *address,
+                   const struct pairup_options *x,
+                   const char *salt)
+{
+    debug_printf (DEBUG_ERROR, "[ ERROR   ] --http is not supported on this platform.\n");
+    return EXIT_FAILURE;
+}
+
+#else
+
+#include <netdb.h>
+#include <strings.h>
+#include <sys/time.h>
+
+/* Largest HTTP header block and body, and how long an idle connection is kept */
+#define HTTP_MAX_HEADER        (8 * 1024)
+#define HTTP_MAX_BODY          (4 * 1024 * 1024)
+#define HTTP_IDLE_SECONDS      5
+
+/* How long a socket client may keep a worker between (or within) messages */
+#define SERVE_IDLE_SECONDS     5
+
+static volatile sig_atomic_t serve_stopping = 0;
+
+static void
+serve_stop (int sig)
+{
+    serve_stopping = 1;
+}
+
+static bool
+serve_read (int fd,
+            void *buffer,
+            size_t size)
+{
+    char *p = (char *) buffer;
+    while (size > 0)
+    {
+        ssize_t n = read (fd, p, size);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool
+serve_write (int fd,
+             const void *buffer,
+             size_t size)
+{
+    const char *p = (const char *) buffer;
+    while (size > 0)
+    {
+        ssize_t n = write (fd, p, size);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+/* One accepted client, handed to a worker */
+struct serve_connection
+{
+    void *context;               // pairup_service or http_server
+    int fd;
+};
+
+/*
+ * Accept clients on `listener` until SIGINT or SIGTERM, running `run` on a
+ * `struct serve_connection` for each. Workers mostly wait on their clients,
+ * so `workers` <= 0 means a few per processor.
+ */
+static void
+serve_accept_loop (int listener,
+                   const char *name,
+                   int workers,
+                   pairup_task run,
+                   void *context)
+{
+    if (workers <= 0)
+    {
+        workers = 4 * pairup_pool_default_threads ();
+    }
+    pairup_pool *pool = pairup_pool_new (workers);
+
+    /* No SA_RESTART: a signal has to interrupt accept() */
+    struct sigaction stop;
+    memset (&stop, 0, sizeof(stop));
+    stop.sa_handler = serve_stop;
+    sigemptyset (&stop.sa_mask);
+    sigaction (SIGINT, &stop, NULL);
+    sigaction (SIGTERM, &stop, NULL);
+    signal (SIGPIPE, SIG_IGN);
+
+    debug_printf (DEBUG_SUMMARY, "[ SUMMARY ] Serving on %s with %d workers.\n",
+                  name, pool ? pairup_pool_threads (pool) : 1);
+    fflush (stdout);
+
+    while (!serve_stopping)
+    {
+        int fd = accept (listener, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno != EINTR)
+            {
+                perror ("accept");
+            }
+            continue;
+        }
+
+        struct serve_connection *c = (struct serve_connection *) malloc (sizeof(struct serve_connection));
+        if (!c)
+        {
+            close (fd);
+            continue;
+        }
+        c->context = context;
+        c->fd = fd;
+
+        if (!pool || !pairup_pool_submit (pool, run, c))
+        {
+            run (c);
+        }
+    }
+
+    /* Clients may still hold their workers, so the pool is left to exit () */
+    close (listener);
+}
+
+static void
+serve_summary (pairup_service *service)
+{
+    struct pairup_service_stats stats;
+    pairup_service_stats (service, &stats);
+
+    debug_printf (DEBUG_SUMMARY, "[ SUMMARY ] Served %zu requests, %zu of them from memory.\n",
+                  stats.requests, stats.hits);
+}
+
+/* ========================================================================= */
+/* Unix domain socket                                                        */
+/* ========================================================================= */
+
+static bool
+serve_send (int fd,
+            const char *reply)
+{
+    size_t size = strlen (reply);
+    unsigned char header[4] = {
+        (unsigned char) (size >> 24), (unsigned char) (size >> 16),
+        (unsigned char) (size >> 8), (unsigned char) size
+    };
+
+    return serve_write (fd, header, sizeof(header)) && serve_write (fd, reply, size);
+}
+
+/* Answer every request of one client, in order, until it hangs up or goes idle */
+static void
+serve_connection_run (void *arg)
+{
+    struct serve_connection *c = (struct serve_connection *) arg;
+    pairup_service *service = (pairup_service *) c->context;
+    unsigned char header[4];
+
+    struct timeval idle = { SERVE_IDLE_SECONDS, 0 };
+    setsockopt (c->fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+
+    while (serve_read (c->fd, header, sizeof(header)))
+    {
+        size_t size = ((size_t) header[0] << 24) | ((size_t) header[1] << 16) |
+                      ((size_t) header[2] << 8) | (size_t) header[3];
+        if (size > SERVE_MAX_MESSAGE)
+        {
+            char *reply = service_error ("Request too large");
+            serve_send (c->fd, reply);
+            free (reply);
+            break;
+        }
+
+        char *request = (char *) malloc (size + 1);
+        if (!request || !serve_read (c->fd, request, size))
+        {
+            free (request);
+            break;
+        }
+        request[size] = '\0';
+
+        char *reply = pairup_service_pair (service, request, size);
+        bool sent = serve_send (c->fd, reply);
+        free (reply);
+        free (request);
+
+        if (!sent)
+        {
+            break;
+        }
+    }
+
+    close (c->fd);
+    free (c);
+}
+
+static int
+serve_listen_unix (const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+
+    if (strlen (path) >= sizeof(addr.sun_path))
+    {
+        debug_printf (DEBUG_ERROR, "[ ERROR   ] Socket path '%s' is too long.\n", path);
+        return -1;
+    }
+
+    /* A socket left behind by an earlier server is replaced, anything else is kept */
+    if (stat (path, &st) == 0 && S_ISSOCK (st.st_mode))
+    {
+        unlink (path);
+    }
+
+    int fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        perror ("socket");
+        return -1;
+    }
+
+    memset (&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, path);
+
+    if (bind (fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen (fd, SOMAXCONN) != 0)
+    {
+        perror (path);
+        close (fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int
+pairup_serve_unix (const char *path,
+                   const struct pairup_options *x,
+                   const char *salt)
+{
+    int listener = serve_listen_unix (path);
+    if (listener < 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    pairup_service *service = pairup_service_new (x, salt);
+    if (!service)
+    {
+        close (listener);
+        unlink (path);
+        return EXIT_FAILURE;
+    }
+
+    serve_accept_loop (listener, path, x->jobs, serve_connection_run, service);
+    unlink (path);
+
+    serve_summary (service);
+    return EXIT_SUCCESS;
+}
+
+/* ========================================================================= */
+/* HTTP/1.1                                                                  */
+/* ========================================================================= */
+
+struct http_server
+{
+    pairup_service *service;
+    double started;
+    size_t connections;          // Atomic
+    size_t responses[6];         // Atomic, by status class (2: 2xx, ...)
+};
+
+struct http_request
+{
+    char method[16];
+    char target[2048];
+    bool keep_alive;
+    bool has_length;
+    bool chunked;
+    bool expect_continue;
+    size_t content_length;
+};
+
+/* A response on its way out */
+struct http_response
+{
+    int status;
+    const char *content_type;
+    char *body;                  // Freed after sending
+    size_t length;
+    const char *allow;           // Allow header of a 405, NULL otherwise
+};
+
+static const char *
+http_reason (int status)
+{
+    switch (status)
+    {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 501: return "Not Implemented";
+        default:  return "Internal Server Error";
+    }
+}
+
+static void
+http_text (struct http_response *response,
+           int status,
+           const char *text)
+{
+    response->status = status;
+    response->content_type = "text/plain; charset=utf-8";
+    response->body = strdup (text);
+    response->length = response->body ? strlen (response->body) : 0;
+}
+
+static bool
+http_send (struct http_server *server,
+           int fd,
+           struct http_response *response,
+           bool keep_alive)
+{
+    char header[512];
+    int n = snprintf (header, sizeof(header),
+                      "HTTP/1.1 %d %s\r\n"
+                      "Content-Type: %s\r\n"
+                      "Content-Length: %zu\r\n"
+                      "%s%s%s"
+                      "Connection: %s\r\n"
+                      "\r\n",
+                      response->status, http_reason (response->status),
+                      response->content_type, response->length,
+                      response->allow ? "Allow: " : "",
+                      response->allow ? response->allow : "",
+                      response->allow ? "\r\n" : "",
+                      keep_alive ? "keep-alive" : "close");
+
+    pairup_atomic_fetch_add (&server->responses[response->status / 100 % 6], 1);
+
+    bool sent = serve_write (fd, header, n) &&
+                serve_write (fd, response->body ? response->body : "", response->length);
+    free (response->body);
+    return sent;
+}
+
+/* Decode %XX and '+' in place */
+static void
+http_url_decode (char *s)
+{
+    char *out = s;
+    for (; *s; s++)
+    {
+        if (*s == '+')
+        {
+            *out++ = ' ';
+        }
+        else if (*s == '%' && isxdigit ((unsigned char) s[1]) && isxdigit ((unsigned char) s[2]))
+        {
+            char hex[3] = { s[1], s[2], '\0' };
+            *out++ = (char) strtol (hex, NULL, 16);
+            s += 2;
+        }
+        else
+        {
+            *out++ = *s;
+        }
+    }
+    *out = '\0';
+}
+
+/* Parse the request line and headers of `text` (NUL terminated, without the blank line) */
+static bool
+http_parse_head (char *text,
+                 struct http_request *request)
+{
+    char version[16];
+    char *line = strtok_r (text, "\r\n", &text);
+
+    memset (request, 0, sizeof(*request));
+    if (!line || sscanf (line, "%15s %2047s %15s", request->method, request->target, version) != 3 ||
+        strncmp (version, "HTTP/1.", 7) != 0)
+    {
+        return false;
+    }
+
+    /* HTTP/1.1 keeps the connection open unless told otherwise, 1.0 the reverse */
+    request->keep_alive = (strcmp (version, "HTTP/1.0") != 0);
+
+    while ((line = strtok_r (NULL, "\r\n", &text)) != NULL)
+    {
+        char *colon = strchr (line, ':');
+        if (!colon)
+        {
+            return false;
+        }
+        *colon = '\0';
+        char *value = colon + 1;
+        while (*value == ' ' || *value == '\t')
+        {
+            value++;
+        }
+
+        if (strcasecmp (line, "Content-Length") == 0)
+        {
+            char *end;
+            request->content_length = strtoul (value, &end, 10);
+            request->has_length = (end != value);
+        }
+        else if (strcasecmp (line, "Transfer-Encoding") == 0)
+        {
+            request->chunked = true;
+        }
+        else if (strcasecmp (line, "Connection") == 0)
+        {
+            if (strcasecmp (value, "close") == 0)
+            {
+                request->keep_alive = false;
+            }
+            else if (strcasecmp (value, "keep-alive") == 0)
+            {
+                request->keep_alive = true;
+            }
+        }
+        else if (strcasecmp (line, "Expect") == 0)
+        {
+            request->expect_continue = (strcasecmp (value, "100-continue") == 0);
+        }
+    }
+
+    return true;
+}
+
+/* POST /pair?priority=OPTIMAL&ensure=Bob: the query takes the request line's options */
+static void
+http_pair (struct http_server *server,
+           char *query,
+           const char *body,
+           size_t size,
+           struct http_response *response)
+{
+    pairup_service *service = server->service;
+    struct pairup_options x = service->defaults;
+    bool ok = false;
+    char error[SERVICE_TOKEN_LEN + 64] = "";
+    char *reply = NULL;
+
+    pairup_atomic_fetch_add (&service->requests, 1);
+
+    udel *elist = (udel *) calloc (1, sizeof(udel));
+    if (!elist)
+    {
+        http_text (response, 500, "Out of memory\n");
+        pairup_atomic_fetch_add (&service->errors, 1);
+        return;
+    }
+
+    char *saveptr = NULL;
+    for (char *param = query ? strtok_r (query, "&", &saveptr) : NULL; param && !error[0];
+         param = strtok_r (NULL, "&", &saveptr))
+    {
+        char *value = strchr (param, '=');
+        if (value)
+        {
+            *value++ = '\0';
+            http_url_decode (value);
+        }
+        http_url_decode (param);
+
+        int arity = service_option_arity (param);
+        if (arity < 0)
+        {
+            snprintf (error, sizeof(error), "Unknown request option '%s'", param);
+        }
+        else if (arity > 0 && !value)
+        {
+            snprintf (error, sizeof(error), "Option '%s' requires a value", param);
+        }
+        else
+        {
+            service_apply_option (param, arity ? value : NULL, &x, elist);
+        }
+    }
+
+    reply = error[0] ? service_error (error) : service_reply (service, &x, body, size, &ok);
+    free (elist);
+    service_finish (service, reply, ok);
+
+    response->status = ok ? 200 : 400;
+    response->content_type = "application/json";
+    response->body = reply;
+    response->length = reply ? strlen (reply) : 0;
+}
+
+/* POST /graph: the relation graph of the sheet in the body, in DOT */
+static void
+http_graph (struct http_server *server,
+            const char *body,
+            size_t size,
+            struct http_response *response)
+{
+    char error[256];
+    sheet *worksheet = (sheet *) calloc (1, sizeof(sheet));
+    if (!worksheet)
+    {
+        http_text (response, 500, "Out of memory\n");
+        return;
+    }
+
+    *worksheet = read_csv_buffer (body, size, "request");
+    if (!pairup_check_sheet (worksheet, error, sizeof(error)))
+    {
+        strcat (error, "\n");
+        http_text (response, 400, error);
+    }
+    else
+    {
+        char *text = NULL;
+        size_t length = 0;
+        FILE *stream = open_memstream (&text, &length);
+        if (stream)
+        {
+            fprint_graph (stream, worksheet);
+            fclose (stream);
+        }
+
+        response->status = text ? 200 : 500;
+        response->content_type = "text/vnd.graphviz";
+        response->body = text;
+        response->length = text ? length : 0;
+    }
+
+    if (worksheet->data)
+    {
+        free_sheet (&worksheet);
+    }
+    else
+    {
+        free (worksheet->path);
+        free (worksheet);
+    }
+}
+
+/* GET /metrics, in the Prometheus text format */
+static void
+http_metrics (struct http_server *server,
+              struct http_response *response)
+{
+    struct pairup_service_stats stats;
+    pairup_service_stats (server->service, &stats);
+
+    char *text = (char *) malloc (2048);
+    if (!text)
+    {
+        http_text (response, 500, "Out of memory\n");
+        return;
+    }
+
+    int n = snprintf (text, 2048,
+"# HELP pairup_requests_total Pairing requests received.\n"
+"# TYPE pairup_requests_total counter\n"
+"pairup_requests_total %zu\n"
+"# HELP pairup_request_errors_total Pairing requests answered with an error.\n"
+"# TYPE pairup_request_errors_total counter\n"
+"pairup_request_errors_total %zu\n"
+"# HELP pairup_cache_hits_total Pairing requests answered from memory.\n"
+"# TYPE pairup_cache_hits_total counter\n"
+"pairup_cache_hits_total %zu\n"
+"# HELP pairup_cache_entries Replies currently kept in memory.\n"
+"# TYPE pairup_cache_entries gauge\n"
+"pairup_cache_entries %zu\n"
+"# HELP pairup_solves_total Sheets solved.\n"
+"# TYPE pairup_solves_total counter\n"
+"pairup_solves_total %zu\n"
+"# HELP pairup_solve_seconds_total Time spent solving sheets.\n"
+"# TYPE pairup_solve_seconds_total counter\n"
+"pairup_solve_seconds_total %.6f\n"
+"# HELP pairup_http_connections_total HTTP connections accepted.\n"
+"# TYPE pairup_http_connections_total counter\n"
+"pairup_http_connections_total %zu\n"
+"# HELP pairup_http_responses_total HTTP responses sent, by status class.\n"
+"# TYPE pairup_http_responses_total counter\n"
+"pairup_http_responses_total{code=\"2xx\"} %zu\n"
+"pairup_http_responses_total{code=\"4xx\"} %zu\n"
+"pairup_http_responses_total{code=\"5xx\"} %zu\n"
+"# HELP pairup_uptime_seconds Time since the server started.\n"
+"# TYPE pairup_uptime_seconds gauge\n"
+"pairup_uptime_seconds %.3f\n",
+                      stats.requests, stats.errors, stats.hits, stats.cached,
+                      stats.solved, stats.solve_ms / 1000.0,
+                      pairup_atomic_load (&server->connections),
+                      pairup_atomic_load (&server->responses[2]),
+                      pairup_atomic_load (&server->responses[4]),
+                      pairup_atomic_load (&server->responses[5]),
+                      (pairup_clock_ms () - server->started) / 1000.0);
+
+    response->status = 200;
+    response->content_type = "text/plain; version=0.0.4";
+    response->body = text;
+    response->length = (n > 0 && n < 2048) ? (size_t) n : strlen (text);
+}
+
+static void
+http_route (struct http_server *server,
+            struct http_request *request,
+            const char *body,
+            struct http_response *response)
+{
+    char *query = strchr (request->target, '?');
+    if (query)
+    {
+        *query++ = '\0';
+    }
+
+    bool post = (strcmp (request->method, "POST") == 0);
+    bool get = (strcmp (request->method, "GET") == 0);
+
+    if (strcmp (request->target, "/pair") == 0)
+    {
+        if (post)
+        {
+            http_pair (server, query, body, request->content_length, response);
+            return;
+        }
+        response->allow = "POST";
+    }
+    else if (strcmp (request->target, "/graph") == 0)
+    {
+        if (post)
+        {
+            http_graph (server, body, request->content_length, response);
+            return;
+        }
+        response->allow = "POST";
+    }
+    else if (strcmp (request->target, "/metrics") == 0)
+    {
+        if (get)
+        {
+            http_metrics (server, response);
+            return;
+        }
+        response->allow = "GET";
+    }
+    else
+    {
+        http_text (response, 404, "Not found\n");
+        return;
+    }
+
+    http_text (response, 405, "Method not allowed\n");
+}
+
+/* Where the header block of `buffer` ends, 0 if it is incomplete */
+static size_t
+http_header_end (const char *buffer,
+                 size_t length)
+{
+    for (size_t i = 3; i < length; i++)
+    {
+        if (buffer[i - 3] == '\r' && buffer[i - 2] == '\n' &&
+            buffer[i - 1] == '\r' && buffer[i] == '\n')
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/* Read more of the connection into `buffer`, false on hang-up, error or idle timeout */
+static bool
+http_fill (int fd,
+           char **buffer,
+           size_t *length,
+           size_t *capacity,
+           size_t want)
+{
+    if (want > *capacity)
+    {
+        char *grown = (char *) realloc (*buffer, want);
+        if (!grown)
+        {
+            return false;
+        }
+        *buffer = grown;
+        *capacity = want;
+    }
+
+    for (;;)
+    {
+        ssize_t n = read (fd, *buffer + *length, *capacity - *length);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        *length += n;
+        return true;
+    }
+}
+
+/* Serve the requests of one client, pipelined or kept alive, until it is done */
+static void
+http_connection_run (void *arg)
+{
+    struct serve_connection *c = (struct serve_connection *) arg;
+    struct http_server *server = (struct http_server *) c->context;
+    size_t length = 0, capacity = HTTP_MAX_HEADER + 1;
+    char *buffer = (char *) malloc (capacity);
+
+    struct timeval idle = { HTTP_IDLE_SECONDS, 0 };
+    setsockopt (c->fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+    pairup_atomic_fetch_add (&server->connections, 1);
+
+    while (buffer && !serve_stopping)
+    {
+        struct http_response response = { 0, NULL, NULL, 0, NULL };
+        struct http_request request;
+
+        size_t head = http_header_end (buffer, length);
+        if (!head)
+        {
+            if (length >= HTTP_MAX_HEADER)
+            {
+                http_text (&response, 431, "Request header too large\n");
+                http_send (server, c->fd, &response, false);
+                break;
+            }
+            if (!http_fill (c->fd, &buffer, &length, &capacity, capacity))
+            {
+                break;
+            }
+            continue;
+        }
+
+        /* The parser writes into the head, the body starts right after it */
+        char saved = buffer[head - 2];
+        buffer[head - 2] = '\0';
+        bool parsed = http_parse_head (buffer, &request);
+        buffer[head - 2] = saved;
+
+        if (!parsed)
+        {
+            http_text (&response, 400, "Malformed request\n");
+            http_send (server, c->fd, &response, false);
+            break;
+        }
+        if (request.chunked)
+        {
+            http_text (&response, 501, "Chunked bodies are not supported\n");
+            http_send (server, c->fd, &response, false);
+            break;
+        }
+        if (strcmp (request.method, "POST") == 0 && !request.has_length)
+        {
+            http_text (&response, 411, "Content-Length required\n");
+            http_send (server, c->fd, &response, false);
+            break;
+        }
+        if (request.content_length > HTTP_MAX_BODY)
+        {
+            http_text (&response, 413, "Request body too large\n");
+            http_send (server, c->fd, &response, false);
+            break;
+        }
+
+        size_t total = head + request.content_length;
+        if (length < total && request.expect_continue)
+        {
+            static const char go_on[] = "HTTP/1.1 100 Continue\r\n\r\n";
+            serve_write (c->fd, go_on, sizeof(go_on) - 1);
+        }
+
+        bool complete = true;
+        while (length < total && complete)
+        {
+            complete = http_fill (c->fd, &buffer, &length, &capacity,
+                                  (total > capacity) ? total : capacity);
+        }
+        if (!complete)
+        {
+            break;
+        }
+
+        http_route (server, &request, buffer + head, &response);
+        if (!http_send (server, c->fd, &response, request.keep_alive) || !request.keep_alive)
+        {
+            break;
+        }
+
+        /* Keep whatever the client pipelined after this request */
+        memmove (buffer, buffer + total, length - total);
+        length -= total;
+    }
+
+    free (buffer);
+    close (c->fd);
+    free (c);
+}
+
+static int
+serve_listen_tcp (const char *address)
+{
+    char host[256], port[32];
+    const char *colon = strrchr (address, ':');
+
+    if (!colon || (size_t) (colon - address) >= sizeof(host) || strlen (colon + 1) >= sizeof(port))
+    {
+        debug_printf (DEBUG_ERROR, "[ ERROR   ] Expected HOST:PORT, got '%s'.\n", address);
+        return -1;
+    }
+
+    /* "[::1]:8080" names an IPv6 host, ":8080" every interface */
+    const char *begin = address, *end = colon;
+    if (*begin == '[' && end > begin && end[-1] == ']')
+    {
+        begin++;
+        end--;
+    }
+    memcpy (host, begin, end - begin);
+    host[end - begin] = '\0';
+    strcpy (port, colon + 1);
+
+    struct addrinfo hints, *found = NULL;
+    memset (&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    int error = getaddrinfo (host[0] ? host : NULL, port, &hints, &found);
+    if (error != 0)
+    {
+        debug_printf (DEBUG_ERROR, "[ ERROR   ] Cannot resolve '%s': %s\n", address, gai_strerror (error));
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *ai = found; ai; ai = ai->ai_next)
+    {
+        fd = socket (ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        int on = 1;
+        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind (fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen (fd, SOMAXCONN) == 0)
+        {
+            break;
+        }
+
+        close (fd);
+        fd = -1;
+    }
+    freeaddrinfo (found);
+
+    if (fd < 0)
+    {
+        perror (address);
+    }
+    return fd;
+}
+
+int
+pairup_serve_http (const char *address,
+                   const struct pairup_options *x,
+                   const char *salt)
+{
+    int listener = serve_listen_tcp (address);
+    if (listener < 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    /* Workers may outlive this call, so the server is never freed */
+    struct http_server *server = (struct http_server *) calloc (1, sizeof(struct http_server));
+    if (server)
+    {
+        server->service = pairup_service_new (x, salt);
+        server->started = pairup_clock_ms ();
+    }
+    if (!server || !server->service)
+    {
+        free (server);
+        close (listener);
+        return EXIT_FAILURE;
+    }
+
+    serve_accept_loop (listener, address, x->jobs, http_connection_run, server);
+
+    serve_summary (server->service);
+    return EXIT_SUCCESS;
+}
+
+#endif
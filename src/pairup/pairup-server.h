@@ -0,0 +1,85 @@
+#ifndef PAIRUP_SERVER_H
+#define PAIRUP_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pairup-types.h"
+
+/*
+ * A long-running pairing service.
+ *
+ * A request is a line of command-line style options (`-p OPTIMAL -e 'Bob'
+ * --seed=7`, possibly empty) followed by the CSV text of a sheet, and the
+ * reply is the JSON document `pairup -j` would print for it. Replies are kept
+ * in memory, keyed like the on-disk cache, so a repeated request is answered
+ * without solving. Without --seed the seed is taken from that key, exactly
+ * as the cached command line does.
+ */
+typedef struct pairup_service pairup_service;
+
+/*
+ * `defaults` are copied, and a nonzero `defaults->seed` seeds every request
+ * that does not bring its own. `salt` (the program version) is mixed into
+ * every key.
+ */
+pairup_service *
+pairup_service_new (const struct pairup_options *defaults,
+                    const char *salt);
+
+/* JSON reply to one request, free with `free` */
+char *
+pairup_service_pair (pairup_service *service,
+                     const char *request,
+                     size_t size);
+
+void
+pairup_service_free (pairup_service *service);
+
+struct pairup_service_stats
+{
+    size_t requests;             // Requests received
+    size_t errors;               // Requests answered with an error document
+    size_t hits;                 // Requests answered from memory
+    size_t cached;               // Replies kept in memory now
+    size_t solved;               // Sheets solved
+    double solve_ms;             // Time spent solving them
+};
+
+void
+pairup_service_stats (pairup_service *service,
+                      struct pairup_service_stats *stats);
+
+/*
+ * Serve requests on the Unix domain socket `path` until SIGINT or SIGTERM.
+ *
+ * Every message, both ways, is a 4-byte big-endian length followed by that
+ * many bytes. A connection may send any number of requests and gets the
+ * replies in order; connections are served by `x->jobs` workers.
+ * Returns the process exit status.
+ */
+int
+pairup_serve_unix (const char *path,
+                   const struct pairup_options *x,
+                   const char *salt);
+
+/*
+ * Serve HTTP/1.1 on `address` ("127.0.0.1:8080", "[::1]:8080" or ":8080")
+ * until SIGINT or SIGTERM:
+ *
+ *   POST /pair      CSV body, JSON result; the query string takes the
+ *                   request line's options: /pair?priority=OPTIMAL&seed=7
+ *   POST /graph     CSV body, the relation graph in DOT
+ *   GET  /metrics   counters in the Prometheus text format
+ *
+ * Connections are kept alive (and may pipeline) until they are idle for a
+ * few seconds; headers and bodies have fixed size limits. Connections are
+ * served by `x->jobs` workers. Returns the process exit status.
+ */
+int
+pairup_serve_http (const char *address,
+                   const struct pairup_options *x,
+                   const char *salt);
+
+#endif  // PAIRUP_SERVER_H
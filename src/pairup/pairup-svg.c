@@ -0,0 +1,389 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pairup-svg.h"
+#include "pairup-algorithm.h"
+#include "pairup-types.h"
+#include "rw-csv.h"
+
+/* Side of the square the layout runs in, per square root of the members */
+#define  SVG_SIDE_PER_ROOT  150.0
+#define  SVG_MIN_SIDE       360.0
+
+/* Room around the layout for the labels */
+#define  SVG_MARGIN         120.0
+
+#define  SVG_ITERATIONS     300
+
+#define  SVG_PI             3.14159265358979323846
+
+#define  SVG_EDGE_COLOR     "#bbbbbb"
+#define  SVG_MATCH_COLOR    "#d62728"
+#define  SVG_NODE_COLOR     "#1f77b4"
+
+struct svg_point
+{
+    double x;
+    double y;
+};
+
+/* Text content or attribute value: the five characters XML reserves are escaped */
+static void
+svg_put_text (FILE *file,
+              const char *text)
+{
+    for (const char *p = text; *p; p++)
+    {
+        switch (*p)
+        {
+            case '&':  fputs ("&amp;", file);  break;
+            case '<':  fputs ("&lt;", file);   break;
+            case '>':  fputs ("&gt;", file);   break;
+            case '"':  fputs ("&quot;", file); break;
+            case '\'': fputs ("&apos;", file); break;
+            default:   fputc (*p, file);       break;
+        }
+    }
+}
+
+/*
+ * Fruchterman-Reingold: edges pull their ends together with d^2/k, every
+ * member pushes the others away with k^2/d, and moves shrink as the layout
+ * cools. As in the original paper, repulsion is cut off at 2k, so members
+ * are bucketed into a grid of 2k cells and only the 3x3 cells around a
+ * member are visited. Starting from a circle keeps the layout deterministic.
+ */
+static void
+svg_layout (struct svg_point pos[],
+            size_t n,
+            const int edge_a[],
+            const int edge_b[],
+            size_t n_edges,
+            double side)
+{
+    double k = side / sqrt ((double) (n ? n : 1));
+    double reach = 2.0 * k;
+    int cells = (int) (side / reach) + 1;
+
+    struct svg_point *disp = (struct svg_point *) calloc (n, sizeof(struct svg_point));
+    int *cell = (int *) malloc (n * sizeof(int));
+    int *order = (int *) malloc (n * sizeof(int));
+    int *start = (int *) malloc ((cells * cells + 1) * sizeof(int));
+    if (!disp || !cell || !order || !start)
+    {
+        free (disp);
+        free (cell);
+        free (order);
+        free (start);
+        return;
+    }
+
+    for (size_t v = 0; v < n; v++)
+    {
+        double angle = 2.0 * SVG_PI * v / n;
+        pos[v].x = side / 2.0 + side / 2.0 * cos (angle);
+        pos[v].y = side / 2.0 + side / 2.0 * sin (angle);
+    }
+
+    for (int iteration = 0; iteration < SVG_ITERATIONS; iteration++)
+    {
+        double temperature = side / 10.0 * (1.0 - (double) iteration / SVG_ITERATIONS);
+
+        /* Counting sort of the members by grid cell */
+        memset (start, 0, (cells * cells + 1) * sizeof(int));
+        for (size_t v = 0; v < n; v++)
+        {
+            int cx = (int) (pos[v].x / reach);
+            int cy = (int) (pos[v].y / reach);
+            cx = (cx < 0) ? 0 : (cx >= cells) ? cells - 1 : cx;
+            cy = (cy < 0) ? 0 : (cy >= cells) ? cells - 1 : cy;
+            cell[v] = cy * cells + cx;
+            start[cell[v] + 1]++;
+        }
+        for (int c = 0; c < cells * cells; c++)
+        {
+            start[c + 1] += start[c];
+        }
+        for (size_t v = 0; v < n; v++)
+        {
+            order[start[cell[v]]++] = (int) v;
+        }
+        for (int c = cells * cells; c > 0; c--)
+        {
+            start[c] = start[c - 1];
+        }
+        start[0] = 0;
+
+        /* Repulsion from the members nearby */
+        for (size_t v = 0; v < n; v++)
+        {
+            int cx = cell[v] % cells;
+            int cy = cell[v] / cells;
+
+            disp[v].x = 0.0;
+            disp[v].y = 0.0;
+            for (int y = cy - 1; y <= cy + 1; y++)
+            {
+                for (int x = cx - 1; x <= cx + 1; x++)
+                {
+                    if (x < 0 || y < 0 || x >= cells || y >= cells)
+                    {
+                        continue;
+                    }
+
+                    int c = y * cells + x;
+                    for (int i = start[c]; i < start[c + 1]; i++)
+                    {
+                        int u = order[i];
+                        if (u == (int) v)
+                        {
+                            continue;
+                        }
+
+                        double dx = pos[v].x - pos[u].x;
+                        double dy = pos[v].y - pos[u].y;
+                        double d = sqrt (dx * dx + dy * dy);
+                        if (d >= reach)
+                        {
+                            continue;
+                        }
+                        if (d < 0.01)
+                        {
+                            /* On top of each other: push apart along the row order */
+                            dx = ((int) v < u) ? -0.01 : 0.01;
+                            dy = 0.0;
+                            d = 0.01;
+                        }
+
+                        double force = k * k / d;
+                        disp[v].x += dx / d * force;
+                        disp[v].y += dy / d * force;
+                    }
+                }
+            }
+        }
+
+        /* Attraction along the edges */
+        for (size_t e = 0; e < n_edges; e++)
+        {
+            int a = edge_a[e];
+            int b = edge_b[e];
+            double dx = pos[a].x - pos[b].x;
+            double dy = pos[a].y - pos[b].y;
+            double d = sqrt (dx * dx + dy * dy);
+            if (d < 0.01)
+            {
+                continue;
+            }
+
+            double force = d * d / k;
+            disp[a].x -= dx / d * force;
+            disp[a].y -= dy / d * force;
+            disp[b].x += dx / d * force;
+            disp[b].y += dy / d * force;
+        }
+
+        /* Move at most `temperature`, and stay inside the square */
+        for (size_t v = 0; v < n; v++)
+        {
+            double d = sqrt (disp[v].x * disp[v].x + disp[v].y * disp[v].y);
+            if (d > 0.0)
+            {
+                double step = (d < temperature) ? d : temperature;
+                pos[v].x += disp[v].x / d * step;
+                pos[v].y += disp[v].y / d * step;
+            }
+            pos[v].x = (pos[v].x < 0.0) ? 0.0 : (pos[v].x > side) ? side : pos[v].x;
+            pos[v].y = (pos[v].y < 0.0) ? 0.0 : (pos[v].y > side) ? side : pos[v].y;
+        }
+    }
+
+    /* Dense graphs pull together in the middle: scale the layout back up to the square */
+    double min_x = side, min_y = side, max_x = 0.0, max_y = 0.0;
+    for (size_t v = 0; v < n; v++)
+    {
+        min_x = (pos[v].x < min_x) ? pos[v].x : min_x;
+        min_y = (pos[v].y < min_y) ? pos[v].y : min_y;
+        max_x = (pos[v].x > max_x) ? pos[v].x : max_x;
+        max_y = (pos[v].y > max_y) ? pos[v].y : max_y;
+    }
+    double extent = (max_x - min_x > max_y - min_y) ? max_x - min_x : max_y - min_y;
+    if (extent > 1.0)
+    {
+        for (size_t v = 0; v < n; v++)
+        {
+            pos[v].x = (pos[v].x - min_x) * side / extent;
+            pos[v].y = (pos[v].y - min_y) * side / extent;
+        }
+    }
+
+    free (disp);
+    free (cell);
+    free (order);
+    free (start);
+}
+
+bool
+fprint_graph_svg (FILE *file,
+                  sheet *worksheet,
+                  const pair_result *result)
+{
+    relation_graph *graph = pairup_graph (worksheet);
+    if (graph == NULL)
+    {
+        fprintf (stderr, "Error: failed to generate graph\n");
+        return false;
+    }
+
+    size_t n = graph->count;
+    struct graph_edge *edges = NULL;
+    size_t n_edges = pairup_graph_edges (graph, &edges);
+
+    /* Rows to layout positions, and the pairs of the result by row */
+    int node_of[MAX_MEMBERS_LEN];
+    uint64_t matched[MAX_MEMBERS_LEN] = { 0 };
+    bool single[MAX_MEMBERS_LEN] = { false };
+
+    for (size_t v = 0; v < n; v++)
+    {
+        node_of[graph->relations[v]->candidates[0]->id] = (int) v;
+    }
+    for (size_t i = 0; result && i < result->pairs; i++)
+    {
+        int a = result->pair_list[i]->a->id;
+        int b = result->pair_list[i]->b->id;
+        matched[a] |= (uint64_t) 1 << b;
+        matched[b] |= (uint64_t) 1 << a;
+    }
+    for (size_t i = 0; result && i < result->singles; i++)
+    {
+        single[result->single_list[i]->id] = true;
+    }
+
+    struct svg_point *pos = (struct svg_point *) calloc (n ? n : 1, sizeof(struct svg_point));
+    int *edge_a = (int *) malloc ((n_edges ? n_edges : 1) * sizeof(int));
+    int *edge_b = (int *) malloc ((n_edges ? n_edges : 1) * sizeof(int));
+    if (!pos || !edge_a || !edge_b || (n_edges > 0 && !edges))
+    {
+        fprintf (stderr, "Error: failed to allocate memory for the layout\n");
+        free (pos);
+        free (edge_a);
+        free (edge_b);
+        free (edges);
+        free_relation_graph (graph);
+        return false;
+    }
+
+    for (size_t e = 0; e < n_edges; e++)
+    {
+        edge_a[e] = node_of[edges[e].a->id];
+        edge_b[e] = node_of[edges[e].b->id];
+    }
+
+    double side = SVG_SIDE_PER_ROOT * sqrt ((double) n);
+    side = (side < SVG_MIN_SIDE) ? SVG_MIN_SIDE : side;
+    svg_layout (pos, n, edge_a, edge_b, n_edges, side);
+
+    double size = side + 2.0 * SVG_MARGIN;
+    fprintf (file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf (file, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%.0f\" height=\"%.0f\" "
+                   "viewBox=\"0 0 %.0f %.0f\" font-family=\"sans-serif\" font-size=\"11\">\n",
+             size, size, size, size);
+    fprintf (file, "  <rect width=\"100%%\" height=\"100%%\" fill=\"white\"/>\n");
+
+    /* Everyone who could meet, hover for the earliest slot */
+    fprintf (file, "  <g stroke=\"" SVG_EDGE_COLOR "\" stroke-width=\"1\">\n");
+    for (size_t e = 0; e < n_edges; e++)
+    {
+        member *a = edges[e].a;
+        member *b = edges[e].b;
+        if (matched[a->id] & ((uint64_t) 1 << b->id))
+        {
+            continue;
+        }
+
+        struct svg_point p = pos[edge_a[e]], q = pos[edge_b[e]];
+        fprintf (file, "    <line x1=\"%.1f\" y1=\"%.1f\" x2=\"%.1f\" y2=\"%.1f\"><title>",
+                 p.x + SVG_MARGIN, p.y + SVG_MARGIN, q.x + SVG_MARGIN, q.y + SVG_MARGIN);
+        svg_put_text (file, a->name);
+        fputs (" -- ", file);
+        svg_put_text (file, b->name);
+        fputs (" (", file);
+        svg_put_text (file, get_time_slot (worksheet, edges[e].time));
+        fputs (")</title></line>\n", file);
+    }
+    fprintf (file, "  </g>\n");
+
+    /* The pairs of the result, labelled with the slot they meet at */
+    fprintf (file, "  <g stroke=\"" SVG_MATCH_COLOR "\" stroke-width=\"3\">\n");
+    for (size_t i = 0; result && i < result->pairs; i++)
+    {
+        const pair *match = result->pair_list[i];
+        struct svg_point p = pos[node_of[match->a->id]], q = pos[node_of[match->b->id]];
+        fprintf (file, "    <line x1=\"%.1f\" y1=\"%.1f\" x2=\"%.1f\" y2=\"%.1f\"/>\n",
+                 p.x + SVG_MARGIN, p.y + SVG_MARGIN, q.x + SVG_MARGIN, q.y + SVG_MARGIN);
+    }
+    fprintf (file, "  </g>\n");
+
+    fprintf (file, "  <g fill=\"" SVG_MATCH_COLOR "\" font-size=\"9\" text-anchor=\"middle\">\n");
+    for (size_t i = 0; result && i < result->pairs; i++)
+    {
+        const pair *match = result->pair_list[i];
+        struct svg_point p = pos[node_of[match->a->id]], q = pos[node_of[match->b->id]];
+        fprintf (file, "    <text x=\"%.1f\" y=\"%.1f\">",
+                 (p.x + q.x) / 2.0 + SVG_MARGIN, (p.y + q.y) / 2.0 + SVG_MARGIN - 3.0);
+        svg_put_text (file, get_time_slot (worksheet, match->time));
+        fputs ("</text>\n", file);
+    }
+    fprintf (file, "  </g>\n");
+
+    /* Members with their requests, paired ones in the colour of their pair */
+    fprintf (file, "  <g>\n");
+    for (size_t v = 0; v < n; v++)
+    {
+        member *m = graph->relations[v]->candidates[0];
+        const char *color = matched[m->id] ? SVG_MATCH_COLOR : single[m->id] ? "white" : SVG_NODE_COLOR;
+
+        fprintf (file, "    <circle cx=\"%.1f\" cy=\"%.1f\" r=\"6\" fill=\"%s\" stroke=\"" SVG_NODE_COLOR "\"/>\n",
+                 pos[v].x + SVG_MARGIN, pos[v].y + SVG_MARGIN, color);
+        fprintf (file, "    <text x=\"%.1f\" y=\"%.1f\">", pos[v].x + SVG_MARGIN + 9.0, pos[v].y + SVG_MARGIN + 4.0);
+        svg_put_text (file, m->name);
+        fprintf (file, ": %zu</text>\n", m->requests);
+    }
+    fprintf (file, "  </g>\n");
+    fprintf (file, "</svg>\n");
+
+    free (pos);
+    free (edge_a);
+    free (edge_b);
+    free (edges);
+    free_relation_graph (graph);
+
+    return true;
+}
+
+void
+generate_graph_output_svg (sheet *worksheet,
+                           const pair_result *result,
+                           const char *filename)
+{
+    FILE *file = fopen (filename, "w");
+    if (file == NULL)
+    {
+        fprintf (stderr, "Error: cannot open file %s\n", filename);
+        return;
+    }
+
+    /* A dense sheet has thousands of edges, write them in large chunks */
+    setvbuf (file, NULL, _IOFBF, 1 << 16);
+
+    bool written = fprint_graph_svg (file, worksheet, result);
+    fclose (file);
+
+    if (written)
+    {
+        printf ("Graph image has been generated to %s\n", filename);
+    }
+}
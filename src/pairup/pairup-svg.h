@@ -0,0 +1,32 @@
+#ifndef PAIRUP_SVG_H
+#define PAIRUP_SVG_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "pairup-types.h"
+#include "rw-csv.h"
+
+/*
+ * The relation graph of `worksheet` as a standalone SVG image, laid out
+ * in-process: no Graphviz needed. Members start on a circle and are then
+ * spread by a force-directed (Fruchterman-Reingold) layout, whose
+ * repulsion only looks at members in neighbouring cells of a grid.
+ *
+ * The pairs of `result` (NULL: none) are drawn thick and labelled with
+ * their slot; `result` has to come from the same (shuffled) sheet, since
+ * members are matched by row. Returns false (after a message) if the
+ * graph cannot be built.
+ */
+bool
+fprint_graph_svg (FILE *file,
+                  sheet *worksheet,
+                  const pair_result *result);
+
+/* `fprint_graph_svg` into `filename` */
+void
+generate_graph_output_svg (sheet *worksheet,
+                           const pair_result *result,
+                           const char *filename);
+
+#endif  // PAIRUP_SVG_H
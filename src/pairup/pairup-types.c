@@ -2,7 +2,9 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include "pairup-types.h"
+#include "pairup-pool.h"
 
 /********************************  Number of practices  *********************************/
 
@@ -118,6 +120,75 @@ bool is_available (const char *sign)
     return (is_once(sign) || is_twice(sign));
 }
 
+size_t slot_ranges (slot_mask slots,
+                    struct slot_range ranges[MAX_RANGES_LEN])
+{
+    /* A run starts at a slot whose predecessor is free and ends at one whose successor is */
+    slot_mask starts = slots & ~(slots << 1);
+    slot_mask ends = slots & ~(slots >> 1);
+    size_t count = 0;
+
+    for (int k = 0; k < MAX_SLOTS_LEN && count < MAX_RANGES_LEN; k++)
+    {
+        if (starts & ((slot_mask) 1 << k))
+        {
+            ranges[count].start = FIELD_COL_START + k;
+        }
+        if (ends & ((slot_mask) 1 << k))
+        {
+            ranges[count++].end = FIELD_COL_START + k;
+        }
+    }
+
+    return count;
+}
+
+double
+pairup_clock_ms (void)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    return (double) clock () * 1000.0 / CLOCKS_PER_SEC;
+#else
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+#endif
+}
+
+void
+pairup_stop_init (struct pairup_stop *stop,
+                  const struct pairup_options *x)
+{
+    stop->deadline = (x->deadline_ms > 0) ? pairup_clock_ms () + x->deadline_ms : 0;
+    stop->cancel = x->cancel;
+    stop->stopped = 0;
+    stop->reached = NULL;
+    stop->index = 0;
+}
+
+bool
+pairup_should_stop (struct pairup_stop *stop)
+{
+    if (!stop)
+    {
+        return false;
+    }
+
+    if (pairup_atomic_load (&stop->stopped))
+    {
+        return true;
+    }
+
+    if ((stop->cancel && pairup_atomic_load (stop->cancel)) ||
+        (stop->deadline > 0 && pairup_clock_ms () >= stop->deadline))
+    {
+        pairup_atomic_store (&stop->stopped, 1);
+        return true;
+    }
+
+    return stop->reached && pairup_atomic_load (stop->reached) < stop->index;
+}
+
 /****************************  Allocator and Deallocator  ********************************/
 
 void
@@ -130,6 +201,24 @@ pairup_options_init (struct pairup_options *x)
     x->priority = false;
     x->debug_level = 2;
     x->json_output = false;
+    x->exact_node_limit = 200000;
+    x->exact_time_limit_ms = 100;
+    x->exact_budget_given = false;
+    x->local_iterations = 100000;
+    x->local_time_limit_ms = 50;
+    x->local_budget_given = false;
+    x->augment = true;
+    x->jobs = 0;
+    x->time_budget_ms = 0;
+    x->seeds = 0;
+    x->stream = false;
+    x->seed = 0;
+    x->seeded = false;
+    x->cache = true;
+    x->cache_dir[0] = '\0';
+    x->deadline_ms = 0;
+    x->cancel = NULL;
+    pairup_stop_init (&x->stop, x);
 }
 
 member_t *
@@ -186,7 +275,7 @@ free_relation (relation *r)
 relation_graph *
 new_relation_graph (void)
 {
-    return (relation_graph *) malloc (sizeof(relation_graph));
+    return (relation_graph *) calloc (1, sizeof(relation_graph));
 }
 
 void
@@ -204,6 +293,11 @@ free_relation_graph (relation_graph *graph)
         graph->relations[i] = NULL;
     }
 
+    for (int i = 0; i < MAX_MEMBERS_LEN; i++)
+    {
+        free_member (graph->members[i]);
+    }
+
     free (graph);
 }
 
@@ -223,6 +317,10 @@ new_pair_result (int pairs,
     result->singles = singles;
     result->pairs = pairs;
     result->algorithm_applied = NULL;
+    result->partial = false;
+    result->upper_bound = 0;
+    result->unsettled = false;
+    memset (result->members, 0, sizeof(result->members));
 
     /* Currently the member graph, single_list, pair_list are not dynamically allocated */
     return result;
@@ -236,5 +334,15 @@ free_pair_result (pair_result *result)
         return;
     }
 
+    for (size_t i = 0; i < result->pairs; i++)
+    {
+        free_pair (result->pair_list[i]);
+    }
+
+    for (int i = 0; i < MAX_MEMBERS_LEN; i++)
+    {
+        free_member (result->members[i]);
+    }
+
     free (result);
 }
@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* Maximum length of the name */
 #define  MAX_NAME_LEN     4096
@@ -17,11 +18,22 @@
 #define  FIELD_COL_START  2 
 #define  FIELD_COL_END    16
 
+/* Number of time slot columns on the sheet */
+#define  MAX_SLOTS_LEN    (FIELD_COL_END - FIELD_COL_START + 1)
+
 /********************************  Types aliasess  ************************************/
 
 /* Slot */
 typedef int slot;
 
+/* Set of slots, bit k stands for the column FIELD_COL_START + k */
+typedef uint32_t slot_mask;
+
+#define  SLOT_BIT(col)    ((slot_mask) 1 << ((col) - FIELD_COL_START))
+
+/* Most runs of consecutive slots a mask can hold: every other slot */
+#define  MAX_RANGES_LEN   ((MAX_SLOTS_LEN + 1) / 2)
+
 /* Member */
 typedef struct member member_t;
 typedef struct member member;  // Recommended
@@ -60,6 +72,7 @@ struct member
     size_t requests;           // Number of requested practices (0, 1 or 2)
     size_t availability;       // Number of slots available on that day
     slot   earliest_slot;      // Earliest time slot on the sheet
+    slot_mask slots;           // Available time slots as a bitmask
     int    ensure_score;       // Ensure score (higher value -> higher priority,
                                //               0 -> feature not used).
 };
@@ -72,6 +85,13 @@ struct pair
     slot time;           // Available time slot for a and b
 };
 
+/* Consecutive slots from `start` to `end` (both included) */
+struct slot_range
+{
+    slot start;
+    slot end;
+};
+
 /* A relation is a member and his/her pairing candidates */
 /* Technically, it's a row in adjacency list representation (See next struct) */
 struct relation
@@ -91,11 +111,23 @@ struct relation_graph
 {
     size_t count;                                // Number of relations
     relation *relations[MAX_MATCHES_LEN];        // Relations
+    member *members[MAX_MEMBERS_LEN];            // Members by row, freed with the graph
+};
+
+struct pairup_options;
+
+/* A pair from an earlier result: member names and the slot label as printed */
+struct previous_pair
+{
+    char a[MAX_NAME_LEN];
+    char b[MAX_NAME_LEN];
+    char time[64];
 };
 
 typedef pair_result *
 (*pairup_internal) (relation_graph *today,
-                    member_t *member_list[]);
+                    member_t *member_list[],
+                    struct pairup_options *x);
 
 struct pairup_algorithm
 {
@@ -114,9 +146,14 @@ struct pair_result
     slot matched_slot[MAX_MATCHES_LEN];
     struct member *member_list[MAX_MATCHES_LEN];
     struct member *single_list[MAX_MATCHES_LEN];
-    char single_suggestion_time[MAX_MEMBERS_LEN][256];  // TODO: find better way avoid BOF
+    struct slot_range single_ranges[MAX_MATCHES_LEN][MAX_RANGES_LEN];  // When each single is available
+    size_t single_range_count[MAX_MATCHES_LEN];
     pair *pair_list[MAX_MATCHES_LEN];
     struct pairup_algorithm *algorithm_applied;
+    bool partial;                // Cut short by a deadline or cancellation
+    size_t upper_bound;          // No result has more pairs, as proven by its solver (0: unknown)
+    bool unsettled;              // A search budget ran out short of the bound: the clock shaped it
+    struct member *members[MAX_MEMBERS_LEN];  // Members the lists point to, freed with the result
 };
 
 /* New feature under development */
@@ -131,6 +168,16 @@ struct user_defined_ensure_list
 // today.relations[i].name;          --> Name of the i-th member in the graph
 // today.relations[i].candidates[j]  --> The j-th candidate of the i-th member
 
+/* When one solve has to give up early, shared by every solver it runs */
+struct pairup_stop
+{
+    double deadline;             // `pairup_clock_ms ()` to give up at (0: never)
+    const int *cancel;           // Give up once this is nonzero (NULL: never)
+    int stopped;                 // Set once a solver gave up
+    const int *reached;          // Give up once this drops below `index` (NULL: never),
+    int index;                   // since the sweep has settled on an earlier result
+};
+
 struct pairup_options
 {
     bool show_csv;
@@ -142,6 +189,24 @@ struct pairup_options
     bool priority;
     char priority_func[1024];
     int  debug_level;
+    size_t exact_node_limit;     // Search nodes the exact solver may expand
+    int  exact_time_limit_ms;    // Wall-clock budget of the exact solver
+    bool exact_budget_given;     // The two above were set, so never scaled to the gap
+    size_t local_iterations;     // Moves the local search may try
+    int  local_time_limit_ms;    // Wall-clock budget of the local search
+    bool local_budget_given;     // The two above were set, so never scaled to the gap
+    bool augment;                // Improve every result with augmenting paths
+    int  jobs;                   // Worker threads for the sweep (0: one per processor)
+    int  time_budget_ms;         // Random multi-start budget after the sweep (0: off)
+    size_t seeds;                // Random multi-start trials (0: as many as time allows)
+    bool stream;                 // Report every multi-start improvement on stderr
+    uint64_t seed;               // Seed of every random choice (same seed, same pairs)
+    bool seeded;                 // `seed` was given (false: it is picked for each run)
+    bool cache;                  // Reuse the result of an identical earlier run
+    char cache_dir[1024];        // Where results are cached ("": the default directory)
+    int  deadline_ms;            // Wall-clock budget of the whole solve (0: none)
+    const int *cancel;           // Set (from any thread) to stop the solve early
+    struct pairup_stop stop;     // Armed from the two above when a solve starts
 };
 
 /********************************  Number of practices  *********************************/
@@ -162,6 +227,26 @@ bool is_twice (const char *sign);
 
 bool is_available (const char *sign);
 
+/* Split `slots` into runs of consecutive slots, earliest first, returns their number */
+size_t slot_ranges (slot_mask slots,
+                    struct slot_range ranges[MAX_RANGES_LEN]);
+
+/* Monotonic clock in milliseconds, for solver budgets */
+double pairup_clock_ms (void);
+
+/* Arm `stop` with the deadline and cancellation flag of `x` */
+void
+pairup_stop_init (struct pairup_stop *stop,
+                  const struct pairup_options *x);
+
+/*
+ * Whether a solver should give up now and return its incumbent. Cheap
+ * enough for every search node; NULL never stops. A result nobody will
+ * look at any more (see `reached`) does not count as stopped early.
+ */
+bool
+pairup_should_stop (struct pairup_stop *stop);
+
 /****************************  Allocator and Deallocator  ********************************/
 
 void
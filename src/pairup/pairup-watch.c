@@ -0,0 +1,497 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pairup-watch.h"
+#include "pairup-algorithm.h"
+#include "pairup-cache.h"
+#include "pairup-formatter.h"
+#include "pairup-types.h"
+#include "rw-csv.h"
+
+#if defined(__linux__)
+
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* The last sheet and result of one file */
+struct watch_entry
+{
+    char name[256];              // File name inside the watched directory
+    uint64_t key;                // Key of the sheet and options last paired
+    sheet *worksheet;            // That sheet, for its slot labels
+    pair_result *result;         // Its result, repaired on the next change
+};
+
+struct watch
+{
+    const char *dir;
+    const char *output;          // Directory or Unix socket
+    bool to_socket;
+    struct pairup_options defaults;
+    const char *salt;
+    struct watch_entry *entries;
+    size_t count;
+};
+
+static volatile sig_atomic_t watch_stopping = 0;
+
+static void
+watch_stop (int sig)
+{
+    watch_stopping = 1;
+}
+
+/* Whether `name` is a sheet to pair up: `*.csv`, but not a hidden file */
+static bool
+watch_is_sheet (const char *name)
+{
+    size_t n = strlen (name);
+    return name[0] != '.' && n > 4 && strcmp (name + n - 4, ".csv") == 0;
+}
+
+static struct watch_entry *
+watch_find (struct watch *w,
+            const char *name)
+{
+    for (size_t i = 0; i < w->count; i++)
+    {
+        if (strcmp (w->entries[i].name, name) == 0)
+        {
+            return &w->entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+static struct watch_entry *
+watch_add (struct watch *w,
+           const char *name)
+{
+    struct watch_entry *entries = (struct watch_entry *) realloc (w->entries,
+                                  (w->count + 1) * sizeof(struct watch_entry));
+    if (!entries)
+    {
+        return NULL;
+    }
+
+    w->entries = entries;
+    struct watch_entry *e = &w->entries[w->count++];
+    memset (e, 0, sizeof(*e));
+    strncpy (e->name, name, sizeof(e->name) - 1);
+    return e;
+}
+
+static void
+watch_forget (struct watch *w,
+              const char *name)
+{
+    struct watch_entry *e = watch_find (w, name);
+    if (!e)
+    {
+        return;
+    }
+
+    free_pair_result (e->result);
+    free_sheet (&e->worksheet);
+    *e = w->entries[--w->count];
+}
+
+/* The whole file, NUL-terminated, NULL if it cannot be read */
+static char *
+watch_read_file (const char *path,
+                 size_t *size)
+{
+    FILE *file = fopen (path, "rb");
+    if (!file)
+    {
+        return NULL;
+    }
+
+    fseek (file, 0, SEEK_END);
+    long length = ftell (file);
+    fseek (file, 0, SEEK_SET);
+
+    char *text = (length >= 0) ? (char *) malloc (length + 1) : NULL;
+    if (text)
+    {
+        *size = fread (text, 1, length, file);
+        text[*size] = '\0';
+    }
+    fclose (file);
+
+    return text;
+}
+
+/* Whether the two sheets offer the same slots, so old pairs still mean the same */
+static bool
+watch_same_slots (sheet *a,
+                  sheet *b)
+{
+    for (int j = FIELD_COL_START; j <= FIELD_COL_END; j++)
+    {
+        if (strcmp (get_time_slot (a, j), get_time_slot (b, j)) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* The pairs of the entry's result, as `--previous` would read them back */
+static struct previous_pair *
+watch_previous_pairs (struct watch_entry *e,
+                      size_t *count)
+{
+    struct previous_pair *previous = (struct previous_pair *) calloc (e->result->pairs + 1,
+                                                                      sizeof(struct previous_pair));
+    if (!previous)
+    {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < e->result->pairs; i++)
+    {
+        pair *p = e->result->pair_list[i];
+        strncpy (previous[i].a, p->a->name, sizeof(previous[i].a) - 1);
+        strncpy (previous[i].b, p->b->name, sizeof(previous[i].b) - 1);
+        strncpy (previous[i].time, get_time_slot (e->worksheet, p->time), sizeof(previous[i].time) - 1);
+    }
+
+    *count = e->result->pairs;
+    return previous;
+}
+
+static bool
+watch_write_all (int fd,
+                 const void *buffer,
+                 size_t size)
+{
+    const char *p = (const char *) buffer;
+    while (size > 0)
+    {
+        ssize_t n = write (fd, p, size);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+/* Send one result to the output socket as a length-prefixed message */
+static bool
+watch_send (struct watch *w,
+            sheet *worksheet,
+            pair_result *result)
+{
+    char *text = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream (&text, &size);
+    if (!out)
+    {
+        return false;
+    }
+    write_result (out, worksheet, result, w->defaults.json_output);
+    fclose (out);
+
+    struct sockaddr_un address;
+    memset (&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy (address.sun_path, w->output, sizeof(address.sun_path) - 1);
+
+    unsigned char header[4] = {
+        (unsigned char) (size >> 24), (unsigned char) (size >> 16),
+        (unsigned char) (size >> 8), (unsigned char) size
+    };
+
+    int fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    bool ok = fd >= 0 &&
+              connect (fd, (struct sockaddr *) &address, sizeof(address)) == 0 &&
+              watch_write_all (fd, header, sizeof(header)) &&
+              watch_write_all (fd, text, size);
+
+    if (fd >= 0)
+    {
+        close (fd);
+    }
+    free (text);
+    return ok;
+}
+
+/* Write NAME.json (or NAME.txt) for NAME.csv: readers see the old file or the new one */
+static bool
+watch_store (struct watch *w,
+             const char *name,
+             sheet *worksheet,
+             pair_result *result)
+{
+    const char *ext = w->defaults.json_output ? "json" : "txt";
+    int stem = (int) (strlen (name) - 4);
+    char path[2048], tmp_path[2048];
+
+    int n = snprintf (path, sizeof(path), "%s/%.*s.%s", w->output, stem, name, ext);
+    int m = snprintf (tmp_path, sizeof(tmp_path), "%s/.%.*s.%s.%d.tmp",
+                      w->output, stem, name, ext, (int) getpid ());
+    if (n <= 0 || (size_t) n >= sizeof(path) || m <= 0 || (size_t) m >= sizeof(tmp_path))
+    {
+        return false;
+    }
+
+    FILE *file = fopen (tmp_path, "wb");
+    if (!file)
+    {
+        return false;
+    }
+
+    write_result (file, worksheet, result, w->defaults.json_output);
+    bool ok = !ferror (file);
+    ok = (fclose (file) == 0) && ok;
+    ok = ok && rename (tmp_path, path) == 0;
+
+    if (!ok)
+    {
+        remove (tmp_path);
+    }
+    return ok;
+}
+
+/* Pair up `name` again if its content changed since the last time */
+static void
+watch_refresh (struct watch *w,
+               const char *name)
+{
+    char path[2048], error[256];
+    size_t size = 0;
+
+    snprintf (path, sizeof(path), "%s/%s", w->dir, name);
+    char *text = watch_read_file (path, &size);
+    if (!text)
+    {
+        return;
+    }
+
+    sheet *worksheet = (sheet *) calloc (1, sizeof(sheet));
+    if (!worksheet)
+    {
+        free (text);
+        return;
+    }
+    *worksheet = read_csv_buffer (text, size, path);
+    free (text);
+
+    if (!pairup_check_sheet (worksheet, error, sizeof(error)))
+    {
+        debug_printf (DEBUG_WARNING, "[ WARNING ] Watch: skipping '%s': %s.\n", name, error);
+        if (worksheet->data)
+        {
+            free_sheet (&worksheet);
+        }
+        else
+        {
+            free (worksheet->path);
+            free (worksheet);
+        }
+        return;
+    }
+
+    struct pairup_options x = w->defaults;
+    uint64_t key = pairup_cache_key (worksheet, &x, w->salt);
+    struct watch_entry *e = watch_find (w, name);
+
+    /* Written again, or a cron job fetched the same export */
+    if (e && e->result && e->key == key)
+    {
+        debug_printf (DEBUG_INFO, "[ INFO    ] Watch: '%s' did not change.\n", name);
+        free_sheet (&worksheet);
+        return;
+    }
+
+    if (!e && !(e = watch_add (w, name)))
+    {
+        free_sheet (&worksheet);
+        return;
+    }
+
+    double start = pairup_clock_ms ();
+    pair_result *result = NULL;
+    struct previous_pair *previous = NULL;
+    size_t count = 0;
+
+    /* Some rows were edited: keep the pairs they still allow */
+    if (e->result && watch_same_slots (e->worksheet, worksheet) &&
+        (previous = watch_previous_pairs (e, &count)) != NULL)
+    {
+        result = pairup_repair (worksheet, previous, count, &x);
+        free (previous);
+    }
+    else
+    {
+        if (!x.seeded)
+        {
+            x.seed = key;
+        }
+        shuffle_worksheet (worksheet, x.seed);
+        result = __pairup__ (worksheet, &x);
+    }
+
+    bool ok = w->to_socket ? watch_send (w, worksheet, result)
+                           : watch_store (w, name, worksheet, result);
+
+    debug_printf (DEBUG_SUMMARY, "\
+[ SUMMARY ] Watch: %s '%s' in %.1f ms, %zu pairs and %zu singles%s.\n",
+previous ? "repaired" : "paired up", name, pairup_clock_ms () - start,
+result->pairs, result->singles, ok ? "" : " (could not write the result)");
+
+    free_pair_result (e->result);
+    free_sheet (&e->worksheet);
+    e->worksheet = worksheet;
+    e->result = result;
+    e->key = key;
+}
+
+int
+pairup_watch (const char *dir,
+              const char *output,
+              const struct pairup_options *x,
+              const char *salt)
+{
+    struct watch w;
+    struct stat st;
+
+    memset (&w, 0, sizeof(w));
+    w.dir = dir;
+    w.output = output ? output : dir;
+    w.defaults = *x;
+    w.salt = salt ? salt : "";
+
+    /* A long-running process is no place for the one-shot extras */
+    w.defaults.generate_graph = false;
+    w.defaults.stream = false;
+
+    if (stat (w.output, &st) != 0 || !(S_ISDIR (st.st_mode) || S_ISSOCK (st.st_mode)))
+    {
+        fprintf (stderr, "pairup: '%s' is neither a directory nor a Unix socket\n", w.output);
+        return EXIT_FAILURE;
+    }
+    w.to_socket = S_ISSOCK (st.st_mode);
+
+    int fd = inotify_init1 (IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch (fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                                              IN_DELETE | IN_DELETE_SELF) < 0)
+    {
+        fprintf (stderr, "pairup: cannot watch '%s': %s\n", dir, strerror (errno));
+        if (fd >= 0)
+        {
+            close (fd);
+        }
+        return EXIT_FAILURE;
+    }
+
+    /* No SA_RESTART: a signal has to interrupt read() */
+    struct sigaction stop;
+    memset (&stop, 0, sizeof(stop));
+    stop.sa_handler = watch_stop;
+    sigemptyset (&stop.sa_mask);
+    sigaction (SIGINT, &stop, NULL);
+    sigaction (SIGTERM, &stop, NULL);
+    signal (SIGPIPE, SIG_IGN);
+
+    /* Whatever is there already */
+    DIR *listing = opendir (dir);
+    if (listing)
+    {
+        struct dirent *entry;
+        while ((entry = readdir (listing)) != NULL && !watch_stopping)
+        {
+            if (watch_is_sheet (entry->d_name))
+            {
+                watch_refresh (&w, entry->d_name);
+            }
+        }
+        closedir (listing);
+    }
+
+    debug_printf (DEBUG_SUMMARY, "[ SUMMARY ] Watching %s, results go to %s.\n", dir, w.output);
+
+    char events[4096] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+    bool gone = false;
+    while (!watch_stopping && !gone)
+    {
+        ssize_t n = read (fd, events, sizeof(events));
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+
+        for (char *p = events; p < events + n && !watch_stopping;)
+        {
+            struct inotify_event *event = (struct inotify_event *) p;
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & (IN_DELETE_SELF | IN_IGNORED))
+            {
+                gone = true;
+            }
+            if (event->len == 0 || !watch_is_sheet (event->name))
+            {
+                continue;
+            }
+
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                watch_forget (&w, event->name);
+            }
+            else
+            {
+                watch_refresh (&w, event->name);
+            }
+        }
+    }
+
+    close (fd);
+    while (w.count > 0)
+    {
+        watch_forget (&w, w.entries[0].name);
+    }
+    free (w.entries);
+
+    if (gone)
+    {
+        fprintf (stderr, "pairup: '%s' is gone\n", dir);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+#else
+
+int
+pairup_watch (const char *dir,
+              const char *output,
+              const struct pairup_options *x,
+              const char *salt)
+{
+    fprintf (stderr, "pairup: --watch needs inotify, which this platform does not have\n");
+    return EXIT_FAILURE;
+}
+
+#endif
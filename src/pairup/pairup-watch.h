@@ -0,0 +1,32 @@
+#ifndef PAIRUP_WATCH_H
+#define PAIRUP_WATCH_H
+
+#include "pairup-types.h"
+
+/*
+ * Pair up every `*.csv` sheet in `dir`, then again whenever one of them is
+ * written, until SIGINT or SIGTERM. Changes are reported by the kernel
+ * (inotify), so nothing is polled, and a sheet whose content and options
+ * hash to the same key as last time is not solved again.
+ *
+ * The last sheet and result of every file stay in memory. When a sheet
+ * changes but keeps its slots, the previous pairs are repaired instead of
+ * solving from scratch (see `pairup_repair`), so members who did not edit
+ * their rows mostly keep their partners.
+ *
+ * `output` is where results go:
+ *   a directory (NULL: `dir`)   NAME.json (NAME.txt without -j) for NAME.csv,
+ *                               written to a temporary file and renamed
+ *   a Unix socket               one length-prefixed message per result, in
+ *                               the framing of `pairup_serve_unix`
+ *
+ * `salt` (the program version) is mixed into every key. Returns the process
+ * exit status.
+ */
+int
+pairup_watch (const char *dir,
+              const char *output,
+              const struct pairup_options *x,
+              const char *salt);
+
+#endif  // PAIRUP_WATCH_H
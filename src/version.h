@@ -0,0 +1,11 @@
+#ifndef VERSION_H
+#define VERSION_H
+
+/* Program version format: version <major>.<minor>.<patch> */
+#define PROGRAM_VERSION "pairup version 1.0." "ec38656" "\n" \
+"Copyright (C) 2025 " "agent" "\n" \
+"License GPLv3: GNU GPL version 3 <https://www.gnu.org/licenses/gpl-3.0.html>.\n" \
+"This is free software: you are free to change and redistribute it.\n" \
+"There is NO WARRANTY, to the extent permitted by law."
+
+#endif  // VERSION_H